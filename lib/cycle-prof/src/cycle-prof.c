@@ -0,0 +1,38 @@
+/**
+ * CCOUNT-based profiling of hot code paths.
+ */
+#include "cycle-prof.h"
+
+#include <osapi.h>
+
+/* --- Functions --- */
+extern void ets_memset(void *, uint8_t, int);
+extern void ets_printf(const char *, ...);
+
+void ICACHE_FLASH_ATTR cycle_prof_reset(struct cycle_prof *prof) { os_memset(prof, 0, sizeof(*prof)); }
+
+void ICACHE_FLASH_ATTR cycle_prof_print(const char *name, const struct cycle_prof *prof) {
+    // Copy first, since an interrupt handler may be updating it.
+    struct cycle_prof p = *prof;
+    if (!p.count)
+        return;
+
+    ets_printf("%s: %u runs, %u min / %u avg / %u max cycles\n", name, p.count, p.min, p.total / p.count, p.max);
+
+    // Only print the populated range.
+    int first = 0;
+    int last = CYCLE_PROF_NUM_BUCKETS - 1;
+    while (!p.hist[first])
+        ++first;
+    while (!p.hist[last])
+        --last;
+
+    ets_printf("  ");
+    for (int i = first; i <= last; ++i) {
+        if (i == CYCLE_PROF_NUM_BUCKETS - 1)
+            ets_printf(" >=%u:%u", 1u << (CYCLE_PROF_MIN_SHIFT + i - 1), p.hist[i]);
+        else
+            ets_printf(" <%u:%u", 1u << (CYCLE_PROF_MIN_SHIFT + i), p.hist[i]);
+    }
+    ets_printf("\n");
+}
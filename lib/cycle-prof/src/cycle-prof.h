@@ -0,0 +1,85 @@
+#ifndef CYCLE_PROF_H_
+#define CYCLE_PROF_H_
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef CYCLE_PROF
+/**
+ * Whether to measure code paths wrapped in CYCLE_PROF_START/CYCLE_PROF_END. If zero, they compile to nothing.
+ */
+#define CYCLE_PROF 0
+#endif
+/**
+ * The number of histogram buckets. Bucket 0 counts runs shorter than 2^CYCLE_PROF_MIN_SHIFT cycles, and each following
+ * bucket is twice as wide as the previous. The last bucket counts everything longer.
+ */
+#define CYCLE_PROF_NUM_BUCKETS 16
+#define CYCLE_PROF_MIN_SHIFT 6
+
+#if CYCLE_PROF
+#define CYCLE_PROF_START(start) uint32_t start = cycle_prof_ccount()
+#define CYCLE_PROF_END(prof, start) cycle_prof_add((prof), cycle_prof_ccount() - (start))
+#else
+#define CYCLE_PROF_START(start)
+#define CYCLE_PROF_END(prof, start)
+#endif
+
+/* --- Types --- */
+/**
+ * Statistics for one code path, in CPU cycles. The owner may reset them at any time.
+ */
+struct cycle_prof {
+    uint32_t count;
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+    uint32_t hist[CYCLE_PROF_NUM_BUCKETS];
+};
+
+/* --- Functions --- */
+/**
+ * Return the CPU cycle counter.
+ */
+static inline uint32_t cycle_prof_ccount(void) {
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+}
+
+/**
+ * Record one run.
+ *
+ * This is inlined, so it can be used from interrupt handlers.
+ *
+ * @param prof the statistics to update.
+ * @param cycles the length of the run.
+ */
+static inline void cycle_prof_add(struct cycle_prof *prof, uint32_t cycles) {
+    if (!prof->count || cycles < prof->min)
+        prof->min = cycles;
+    if (cycles > prof->max)
+        prof->max = cycles;
+    ++prof->count;
+    prof->total += cycles;
+
+    uint8_t i = 0;
+    while (i < CYCLE_PROF_NUM_BUCKETS - 1 && cycles >> (CYCLE_PROF_MIN_SHIFT + i))
+        ++i;
+    ++prof->hist[i];
+}
+
+/**
+ * Clear the statistics.
+ */
+extern void ICACHE_FLASH_ATTR cycle_prof_reset(struct cycle_prof *prof);
+
+/**
+ * Print the statistics on the console, on two lines. Does nothing if there have been no runs.
+ *
+ * @param name the name of the code path.
+ * @param prof the statistics to print.
+ */
+extern void ICACHE_FLASH_ATTR cycle_prof_print(const char *name, const struct cycle_prof *prof);
+
+#endif /* CYCLE_PROF_H_ */
@@ -0,0 +1,96 @@
+// From
+// https://github.com/espressif/ESP8266_MP3_DECODER/blob/151b5ec581187419b382e6c523bdc0ed8ff5f38b/mp3/include/slc_register.h
+//
+// The SLC is the DMA engine that feeds the I2S TX FIFO. From its point of view, data going out to I2S is "RX".
+
+#define REG_SLC_BASE (0x60000B00)
+
+#define SLC_CONF0 (REG_SLC_BASE + 0x0)
+#define SLC_MODE 0x00000003
+#define SLC_MODE_S 12
+#define SLC_DATA_BURST_EN (BIT(9))
+#define SLC_DSCR_BURST_EN (BIT(8))
+#define SLC_RX_NO_RESTART_CLR (BIT(7))
+#define SLC_RX_AUTO_WRBACK (BIT(6)) // Clear the owner bit when a descriptor has been consumed
+#define SLC_RX_LOOP_TEST (BIT(5))
+#define SLC_TX_LOOP_TEST (BIT(4))
+#define SLC_AHBM_RST (BIT(3))
+#define SLC_AHBM_FIFO_RST (BIT(2))
+#define SLC_RXLINK_RST (BIT(1))
+#define SLC_TXLINK_RST (BIT(0))
+
+#define SLC_INT_RAW (REG_SLC_BASE + 0x4)
+#define SLC_TX_DSCR_EMPTY_INT_RAW (BIT(21))
+#define SLC_RX_DSCR_ERR_INT_RAW (BIT(20))
+#define SLC_TX_DSCR_ERR_INT_RAW (BIT(19))
+#define SLC_TOHOST_INT_RAW (BIT(18))
+#define SLC_RX_EOF_INT_RAW (BIT(17)) // A descriptor with the eof flag has been consumed
+#define SLC_RX_DONE_INT_RAW (BIT(16))
+#define SLC_TX_EOF_INT_RAW (BIT(15))
+#define SLC_TX_DONE_INT_RAW (BIT(14))
+
+#define SLC_INT_STATUS (REG_SLC_BASE + 0x8)
+#define SLC_TX_DSCR_EMPTY_INT_ST (BIT(21))
+#define SLC_RX_DSCR_ERR_INT_ST (BIT(20))
+#define SLC_TX_DSCR_ERR_INT_ST (BIT(19))
+#define SLC_TOHOST_INT_ST (BIT(18))
+#define SLC_RX_EOF_INT_ST (BIT(17))
+#define SLC_RX_DONE_INT_ST (BIT(16))
+#define SLC_TX_EOF_INT_ST (BIT(15))
+#define SLC_TX_DONE_INT_ST (BIT(14))
+
+#define SLC_INT_ENA (REG_SLC_BASE + 0xC)
+#define SLC_TX_DSCR_EMPTY_INT_ENA (BIT(21))
+#define SLC_RX_DSCR_ERR_INT_ENA (BIT(20))
+#define SLC_TX_DSCR_ERR_INT_ENA (BIT(19))
+#define SLC_TOHOST_INT_ENA (BIT(18))
+#define SLC_RX_EOF_INT_ENA (BIT(17))
+#define SLC_RX_DONE_INT_ENA (BIT(16))
+#define SLC_TX_EOF_INT_ENA (BIT(15))
+#define SLC_TX_DONE_INT_ENA (BIT(14))
+
+#define SLC_INT_CLR (REG_SLC_BASE + 0x10)
+#define SLC_TX_DSCR_EMPTY_INT_CLR (BIT(21))
+#define SLC_RX_DSCR_ERR_INT_CLR (BIT(20))
+#define SLC_TX_DSCR_ERR_INT_CLR (BIT(19))
+#define SLC_TOHOST_INT_CLR (BIT(18))
+#define SLC_RX_EOF_INT_CLR (BIT(17))
+#define SLC_RX_DONE_INT_CLR (BIT(16))
+#define SLC_TX_EOF_INT_CLR (BIT(15))
+#define SLC_TX_DONE_INT_CLR (BIT(14))
+
+#define SLC_RX_STATUS (REG_SLC_BASE + 0x14)
+#define SLC_RX_EMPTY (BIT(1))
+#define SLC_RX_FULL (BIT(0))
+
+#define SLC_TX_STATUS (REG_SLC_BASE + 0x20)
+#define SLC_TX_EMPTY (BIT(1))
+#define SLC_TX_FULL (BIT(0))
+
+#define SLC_RX_LINK (REG_SLC_BASE + 0x24)
+#define SLC_RXLINK_PARK (BIT(31))
+#define SLC_RXLINK_RESTART (BIT(30))
+#define SLC_RXLINK_START (BIT(29))
+#define SLC_RXLINK_STOP (BIT(28))
+#define SLC_RXLINK_DESCADDR_MASK 0x000FFFFF
+#define SLC_RXLINK_ADDR_S 0
+
+#define SLC_TX_LINK (REG_SLC_BASE + 0x28)
+#define SLC_TXLINK_PARK (BIT(31))
+#define SLC_TXLINK_RESTART (BIT(30))
+#define SLC_TXLINK_START (BIT(29))
+#define SLC_TXLINK_STOP (BIT(28))
+#define SLC_TXLINK_DESCADDR_MASK 0x000FFFFF
+#define SLC_TXLINK_ADDR_S 0
+
+#define SLC_RX_EOF_DES_ADDR (REG_SLC_BASE + 0x48)
+#define SLC_TX_EOF_DES_ADDR (REG_SLC_BASE + 0x4C)
+
+#define SLC_RX_DSCR_CONF (REG_SLC_BASE + 0x98)
+#define SLC_RX_FILL_EN (BIT(20))
+#define SLC_RX_EOF_MODE (BIT(19))
+#define SLC_RX_FILL_MODE (BIT(18))
+#define SLC_INFOR_NO_REPLACE (BIT(9))
+#define SLC_TOKEN_NO_REPLACE (BIT(8))
+
+#define SLC_DSCR_MAX_DATALEN 4095 // Bytes per descriptor
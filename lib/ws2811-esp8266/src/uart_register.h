@@ -0,0 +1,56 @@
+// From driver_lib/include/driver/uart_register.h in the ESP8266 NONOS SDK.
+//
+// Only the registers used by this project.
+
+#define REG_UART_BASE(i) (0x60000000 + (i)*0xf00)
+
+#define UART_FIFO(i) (REG_UART_BASE(i) + 0x0)
+#define UART_RXFIFO_RD_BYTE 0x000000FF
+#define UART_RXFIFO_RD_BYTE_S 0
+
+#define UART_INT_RAW(i) (REG_UART_BASE(i) + 0x4)
+#define UART_INT_ST(i) (REG_UART_BASE(i) + 0x8)
+#define UART_INT_ENA(i) (REG_UART_BASE(i) + 0xC)
+#define UART_INT_CLR(i) (REG_UART_BASE(i) + 0x10)
+#define UART_RXFIFO_TOUT_INT (BIT(8)) // The RX line has been idle for UART_RX_TOUT_THRHD byte times
+#define UART_BRK_DET_INT (BIT(7))
+#define UART_CTS_CHG_INT (BIT(6))
+#define UART_DSR_CHG_INT (BIT(5))
+#define UART_RXFIFO_OVF_INT (BIT(4))
+#define UART_FRM_ERR_INT (BIT(3))
+#define UART_PARITY_ERR_INT (BIT(2))
+#define UART_TXFIFO_EMPTY_INT (BIT(1)) // The TX FIFO has fewer than UART_TXFIFO_EMPTY_THRHD bytes
+#define UART_RXFIFO_FULL_INT (BIT(0))  // The RX FIFO has more than UART_RXFIFO_FULL_THRHD bytes
+
+#define UART_CLKDIV(i) (REG_UART_BASE(i) + 0x14)
+#define UART_CLKDIV_CNT 0x000FFFFF
+#define UART_CLKDIV_S 0
+
+#define UART_STATUS(i) (REG_UART_BASE(i) + 0x1C)
+#define UART_TXD (BIT(31))
+#define UART_TXFIFO_CNT 0x000000FF
+#define UART_TXFIFO_CNT_S 16
+#define UART_RXFIFO_CNT 0x000000FF
+#define UART_RXFIFO_CNT_S 0
+
+#define UART_CONF0(i) (REG_UART_BASE(i) + 0x20)
+#define UART_TXD_INV (BIT(22))
+#define UART_TXFIFO_RST (BIT(18))
+#define UART_RXFIFO_RST (BIT(17))
+#define UART_STOP_BIT_NUM 0x00000003
+#define UART_STOP_BIT_NUM_S 4
+#define UART_BIT_NUM 0x00000003 // Data bits minus five
+#define UART_BIT_NUM_S 2
+#define UART_PARITY_EN (BIT(1))
+#define UART_PARITY (BIT(0))
+
+#define UART_CONF1(i) (REG_UART_BASE(i) + 0x24)
+#define UART_RX_TOUT_EN (BIT(31))
+#define UART_RX_TOUT_THRHD 0x0000007F
+#define UART_RX_TOUT_THRHD_S 24
+#define UART_TXFIFO_EMPTY_THRHD 0x0000007F
+#define UART_TXFIFO_EMPTY_THRHD_S 8
+#define UART_RXFIFO_FULL_THRHD 0x0000007F
+#define UART_RXFIFO_FULL_THRHD_S 0
+
+#define UART_FIFO_LEN 128 // Bytes, in each direction
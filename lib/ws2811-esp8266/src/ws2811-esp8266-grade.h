@@ -0,0 +1,84 @@
+#ifndef WS2811_ESP8266_GRADE_H_
+#define WS2811_ESP8266_GRADE_H_
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef WS2811_GRADE_GAMMA
+/**
+ * Whether to apply a gamma of 2.2, so pixel values are perceptual rather than linear.
+ */
+#define WS2811_GRADE_GAMMA 1
+#endif
+/**
+ * Number of channels graded per pixel. The byte above them is passed through as zero.
+ */
+#define WS2811_GRADE_CHANNELS 3
+
+/* --- Types --- */
+/**
+ * Colour grading: gamma, brightness and temporal dithering.
+ *
+ * Gamma and brightness are folded into one table of 8.8 fixed-point output levels. The fraction that doesn't fit in
+ * eight bits is carried to the next frame in a residual per channel, so over a few frames the LEDs show the full 16-bit
+ * level. Only the table is shared. Each output keeps its own residuals.
+ *
+ * Dithering needs every frame to be sent. While the picture is static, it can be turned off, and the levels are then
+ * rounded instead, so repeated frames look the same.
+ */
+struct ws2811_grade {
+    uint16_t lut[256]; // 8.8 fixed-point output level of each input level
+    uint8_t brightness;
+    bool dither;
+};
+
+/* --- Functions --- */
+/**
+ * Initialize the grading table, with dithering on.
+ *
+ * @param grade the grading to initialize.
+ * @param brightness the global brightness. 255 is full.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_grade_init(struct ws2811_grade *grade, uint8_t brightness);
+
+/**
+ * Change the global brightness. Rebuilds the table.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_grade_set_brightness(struct ws2811_grade *grade, uint8_t brightness);
+
+/**
+ * Grade one pixel.
+ *
+ * @param grade the grading.
+ * @param p the pixel.
+ * @param residual the dither residuals of the pixel, WS2811_GRADE_CHANNELS bytes. Updated if dithering.
+ * @return the graded pixel.
+ */
+static inline uint32_t ws2811_grade_pixel(const struct ws2811_grade *grade, uint32_t p, uint8_t *residual) {
+    uint32_t out = 0;
+    for (int i = 0; i < WS2811_GRADE_CHANNELS; ++i, p >>= 8) {
+        uint32_t v = grade->lut[p & 0xFF];
+        if (grade->dither) {
+            v += residual[i];
+            residual[i] = v;
+        } else {
+            v += 0x80;
+        }
+        out |= (v >> 8) << (8 * i);
+    }
+    return out;
+}
+
+/**
+ * Grade a buffer into another, for drivers that can't do it while encoding.
+ *
+ * @param grade the grading.
+ * @param dst the graded pixels, e.g. the driver's back buffer. May be src.
+ * @param src the pixels.
+ * @param residual the dither residuals, WS2811_GRADE_CHANNELS bytes per pixel.
+ * @param len the number of pixels.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_grade_apply(const struct ws2811_grade *grade, uint32_t *dst, const uint32_t *src,
+                                                 uint8_t *residual, size_t len);
+
+#endif /* WS2811_ESP8266_GRADE_H_ */
@@ -4,6 +4,12 @@
  * Using FIFO for simplicity over DMA. The buffers are deep enough that simple timing is not a problem. Unlike the SPI
  * subsystem, I2S has an interrupt that fires at a configurable low mark. SPI only has an "empty" which is too late.
  *
+ * The frame is encoded into I2S samples in ws2811_i2s_commit, so the interrupt handler only copies words into the FIFO.
+ * There are two sample buffers. The interrupt handler latches a committed frame when the previous one has been sent.
+ *
+ * With WS2811_I2S_USE_DMA, the samples are instead handed to the SLC DMA engine as a descriptor chain. The CPU then
+ * only sees one interrupt when the last descriptor has been consumed, and one when the FIFO drains.
+ *
  * Inspired by
  *   https://github.com/CHERTS/esp8266-devkit/blob/ffbaaa3199ee603ee12f8c12826891c07bd8cc8a/Espressif/examples/ESP8266/I2S_Demo/driver/i2s.c
  *   https://github.com/espressif/esp-idf/blob/1f055d28b89cb4f3bd4be02eb1d7c75adbc08331/components/driver/i2s.c
@@ -23,6 +29,12 @@
 #endif
 
 /* --- Macros --- */
+#if WS2811_I2S_ENCODE_IN_ISR && (WS2811_I2S_USE_DMA || WS2811_I2S_LUT_IN_FLASH)
+#error "WS2811_I2S_ENCODE_IN_ISR needs FIFO mode and the lookup table in RAM"
+#endif
+#if WS2811_I2S_GRADE && WS2811_I2S_BITS_PER_PIXEL != 8 * WS2811_GRADE_CHANNELS
+#error "WS2811_I2S_GRADE needs WS2811_I2S_BITS_PER_PIXEL of 24"
+#endif
 #define WS2811_I2S_TRES 50000 // ns
 #define WS2811_I2S_T0H 425    // ns
 #define WS2811_I2S_TBIT (3 * WS2811_I2S_T0H)
@@ -34,10 +46,51 @@
 // 68 = clkm * bck, where 0 < clk, bck < 64
 #define WS2811_I2S_BCK 4
 #define WS2811_I2S_CLKM 17
+#define WS2811_I2S_BASE_FREQ 160 // MHz, before the CLKM and BCK dividers
+
+// Check the resulting wire timing against the WS2812B datasheet (doc/ws2812b.pdf), which allows ±150 ns on each.
+// One I2S bit is T0H and T1L, and two are T1H and T0L.
+#define WS2811_I2S_TSYMBOL (WS2811_I2S_BCK * WS2811_I2S_CLKM * 1000 / WS2811_I2S_BASE_FREQ) // ns
+#define WS2811_I2S_IN_SPEC(t, nominal) ((t) + 150 >= (nominal) && (t) <= (nominal) + 150)
+#if WS2811_I2S_TSYMBOL != WS2811_I2S_T0H
+#error "WS2811_I2S_BCK and WS2811_I2S_CLKM don't match WS2811_I2S_T0H"
+#endif
+#if !WS2811_I2S_IN_SPEC(WS2811_I2S_TSYMBOL, 400) || !WS2811_I2S_IN_SPEC(2 * WS2811_I2S_TSYMBOL, 800) ||             \
+    !WS2811_I2S_IN_SPEC(2 * WS2811_I2S_TSYMBOL, 850) || !WS2811_I2S_IN_SPEC(WS2811_I2S_TSYMBOL, 450)
+#error "The I2S bit timing is outside the WS2812B datasheet limits"
+#endif
 
 #define WS2811_SPI_INT_ST (PERIPHS_DPORT_BASEADDR | 0x20)
 #define WS2811_SPI_INT_ST_I2S BIT9
 
+#define WS2811_I2S_FRAME_TIME (2 * 8 * WS2811_I2S_TBIT)
+#define WS2811_I2S_REMPTY_DELAY_FRAMES (2 - 1)
+// The precision of os_timer_arm_us is 500 µs, which is much higher than TBIT.
+// We continue filling the FIFO with zero instead, giving us better precision.
+// We need to write at least one frame to ensure the last data byte isn't repeating.
+// The REMPTY interrupt comes two frames early, but since the hardware starts each transfer with one zero frame,
+// we can discount one.
+// The trailer length is in samples.
+#define WS2811_I2S_TRAILER_LEN                                                                                         \
+    (2 * ((WS2811_I2S_TRES + WS2811_I2S_FRAME_TIME - 1) / WS2811_I2S_FRAME_TIME + WS2811_I2S_REMPTY_DELAY_FRAMES))
+#if WS2811_I2S_TRAILER_LEN + 1 > WS2811_I2S_MAX_TRAILER_LEN
+#error "WS2811_I2S_MAX_TRAILER_LEN is too small for the reset time"
+#endif
+
+#if WS2811_I2S_PROFILE
+#define WS2811_I2S_PROFILE_START(ctx) uint32_t prof_start = cycle_prof_ccount()
+#define WS2811_I2S_PROFILE_END(ctx, what) cycle_prof_add(&(ctx)->prof.what, cycle_prof_ccount() - prof_start)
+#define WS2811_I2S_PROFILE_FRAME_DONE(ctx) ws2811_i2s_profile_frame_done(&(ctx)->prof)
+#else
+#define WS2811_I2S_PROFILE_START(ctx)
+#define WS2811_I2S_PROFILE_END(ctx, what)
+#define WS2811_I2S_PROFILE_FRAME_DONE(ctx)
+#endif
+
+#ifndef ETS_SLC_INUM
+#define ETS_SLC_INUM 1
+#endif
+
 /* --- Functions --- */
 extern void ets_isr_attach(int, void (*)(void *), void *);
 extern void ets_isr_mask(uint32_t);
@@ -50,23 +103,176 @@ extern void rom_i2c_writeReg_Mask(uint8_t block, uint8_t host_id, uint32_t reg_a
                                   uint8_t indata);
 
 /* --- Data --- */
-static const uint16_t NIBBLE_PWM[] = {
 #define PWM_BIT(b) ((b) ? 6 : 4)
-#define PWM_WORD(v) (PWM_BIT((v)&8) << 9) | (PWM_BIT((v)&4) << 6) | (PWM_BIT((v)&2) << 3) | PWM_BIT((v)&1)
+#define PWM_WORD(v) ((PWM_BIT((v)&8) << 9) | (PWM_BIT((v)&4) << 6) | (PWM_BIT((v)&2) << 3) | PWM_BIT((v)&1))
+#if WS2811_I2S_LUT_IN_FLASH
+// Flash only supports aligned 32-bit loads.
+#define WS2811_I2S_LUT_ATTR ICACHE_RODATA_ATTR
+typedef uint32_t ws2811_i2s_nibble_pwm;
+#else
+#define WS2811_I2S_LUT_ATTR
+typedef uint16_t ws2811_i2s_nibble_pwm;
+#endif
+#if WS2811_I2S_LUT == WS2811_I2S_LUT_BYTE
+/**
+ * The 24-bit I2S symbol for each byte value, placed in the MSB of the sample.
+ */
+static const uint32_t BYTE_PWM[] WS2811_I2S_LUT_ATTR = {
+#define PWM_BYTE(v) (((uint32_t)PWM_WORD((v) >> 4) << (32 - 12)) | ((uint32_t)PWM_WORD((v)&0xF) << (32 - 24)))
+#define PWM_BYTE4(v) PWM_BYTE(v), PWM_BYTE((v) + 1), PWM_BYTE((v) + 2), PWM_BYTE((v) + 3)
+#define PWM_BYTE16(v) PWM_BYTE4(v), PWM_BYTE4((v) + 4), PWM_BYTE4((v) + 8), PWM_BYTE4((v) + 12)
+#define PWM_BYTE64(v) PWM_BYTE16(v), PWM_BYTE16((v) + 16), PWM_BYTE16((v) + 32), PWM_BYTE16((v) + 48)
+    PWM_BYTE64(0), PWM_BYTE64(64), PWM_BYTE64(128), PWM_BYTE64(192),
+#undef PWM_BYTE64
+#undef PWM_BYTE16
+#undef PWM_BYTE4
+#undef PWM_BYTE
+};
+#else
+static const ws2811_i2s_nibble_pwm NIBBLE_PWM[] WS2811_I2S_LUT_ATTR = {
     PWM_WORD(0), PWM_WORD(1), PWM_WORD(2),  PWM_WORD(3),  PWM_WORD(4),  PWM_WORD(5),  PWM_WORD(6),  PWM_WORD(7),
     PWM_WORD(8), PWM_WORD(9), PWM_WORD(10), PWM_WORD(11), PWM_WORD(12), PWM_WORD(13), PWM_WORD(14), PWM_WORD(15),
+};
+#endif
 #undef PWM_WORD
 #undef PWM_BIT
-};
 
 static inline void bbpll_set_i2s_clock(bool b) { rom_i2c_writeReg_Mask(0x67, 4, 4, 7, 7, b ? 1 : 0); }
 
+/**
+ * Return the sample for one colour byte. The 24 bits are placed in the MSB.
+ *
+ * Must be in IRAM, used by ISR with WS2811_I2S_ENCODE_IN_ISR.
+ */
+static inline uint32_t ws2811_i2s_symbol(uint8_t v) {
+#if WS2811_I2S_LUT == WS2811_I2S_LUT_BYTE
+    return BYTE_PWM[v];
+#else
+    return ((uint32_t)NIBBLE_PWM[v >> 4] << (32 - 12)) | ((uint32_t)NIBBLE_PWM[v & 0xF] << (32 - 24));
+#endif
+}
+
+/**
+ * Return the number of zero samples to send after len pixels.
+ */
+static inline int ws2811_i2s_trailer_len(size_t len) {
+    // The total output must be even since we have two channels.
+    return WS2811_I2S_TRAILER_LEN + ((WS2811_I2S_BITS_PER_PIXEL / 8 * len + WS2811_I2S_TRAILER_LEN) & 1);
+}
+
+#if WS2811_I2S_PROFILE
+/**
+ * Fold the interrupt count of the frame that just finished into the per-frame statistics.
+ *
+ * Must be in IRAM, used by ISR.
+ */
+static inline void ws2811_i2s_profile_frame_done(struct ws2811_i2s_profile *prof) {
+    uint32_t n = prof->isr.count - prof->frame_start_isrs;
+    ++prof->frames;
+    if (n > prof->max_frame_isrs)
+        prof->max_frame_isrs = n;
+    prof->frame_start_isrs = prof->isr.count;
+}
+#endif
+
+/**
+ * Encode the pixels and the reset trailer into samples. With WS2811_I2S_ENCODE_IN_ISR, only grade them.
+ *
+ * Runs in task context, so it doesn't need to be in IRAM.
+ */
+static void ICACHE_FLASH_ATTR ws2811_i2s_encode(struct ws2811_i2s_context *ctx, struct ws2811_i2s_frame *frame,
+                                                const uint32_t *buf, size_t len) {
+    WS2811_I2S_PROFILE_START(ctx);
+    uint32_t *sp = frame->samples;
+#if WS2811_I2S_GRADE
+    uint8_t *residual = ctx->residual;
+#endif
+    for (const uint32_t *end = buf + len; buf != end; ++buf) {
+        uint32_t p = *buf;
+#if WS2811_I2S_GRADE
+        if (ctx->grade)
+            p = ws2811_grade_pixel(ctx->grade, p, residual);
+        residual += WS2811_GRADE_CHANNELS;
+#endif
+#if WS2811_I2S_ENCODE_IN_ISR
+        *sp++ = p;
+    }
+#else
+        for (int bit = 0; bit < WS2811_I2S_BITS_PER_PIXEL; bit += 8) {
+            *sp++ = ws2811_i2s_symbol(p >> bit);
+        }
+    }
+    for (int i = ws2811_i2s_trailer_len(len); i; --i) {
+        *sp++ = 0;
+    }
+#endif
+
+    frame->len = sp - frame->samples;
+    WS2811_I2S_PROFILE_END(ctx, encode);
+}
+
+#if WS2811_I2S_USE_DMA
+/**
+ * Link the encoded samples into the DMA descriptor chain.
+ */
+static void ICACHE_FLASH_ATTR ws2811_i2s_dma_link(struct ws2811_i2s_frame *frame) {
+    const uint32_t *data = frame->samples;
+    size_t left = frame->len * sizeof(*data);
+    struct ws2811_i2s_dma_desc *desc = frame->descs;
+    for (;; ++desc) {
+        size_t n = (left > SLC_DSCR_MAX_DATALEN ? SLC_DSCR_MAX_DATALEN & ~3 : left);
+        desc->blocksize = n;
+        desc->datalen = n;
+        desc->unused = 0;
+        desc->sub_sof = 0;
+        desc->owner = 1;
+        desc->buf = data;
+        data += n / sizeof(*data);
+        left -= n;
+        if (!left)
+            break;
+        desc->eof = 0;
+        desc->next = desc + 1;
+    }
+    desc->eof = 1;
+    desc->next = NULL;
+}
+
+/**
+ * Point the SLC at the first descriptor and start it. The I2S transmitter must be stopped.
+ *
+ * Must be in IRAM, used by ISR.
+ */
+static void ws2811_i2s_dma_start(struct ws2811_i2s_frame *frame) {
+    SET_PERI_REG_MASK(SLC_CONF0, SLC_RXLINK_RST);
+    CLEAR_PERI_REG_MASK(SLC_CONF0, SLC_RXLINK_RST);
+    WRITE_PERI_REG(SLC_INT_CLR, 0xFFFFFFFF);
+    CLEAR_PERI_REG_MASK(SLC_RX_LINK, SLC_RXLINK_STOP | SLC_RXLINK_DESCADDR_MASK);
+    SET_PERI_REG_MASK(SLC_RX_LINK, ((uint32_t)frame->descs) & SLC_RXLINK_DESCADDR_MASK);
+    SET_PERI_REG_MASK(SLC_RX_LINK, SLC_RXLINK_START);
+}
+
+// Must be in IRAM.
+static void ws2811_i2s_slc_intr(void *cookie) {
+    struct ws2811_i2s_context *ctx = (struct ws2811_i2s_context *)cookie;
+    WS2811_I2S_PROFILE_START(ctx);
+    uint32_t int_st = READ_PERI_REG(SLC_INT_STATUS);
+    WRITE_PERI_REG(SLC_INT_CLR, 0xFFFFFFFF);
+
+    if (int_st & SLC_RX_EOF_INT_ST) {
+        // All samples, including the trailer, are in the FIFO. Let the I2S interrupt stop it once it drains.
+        ctx->state = WS2811_I2S_STATE_RESET;
+        WRITE_PERI_REG(I2SINT_CLR, I2S_I2S_TX_REMPTY_INT_CLR);
+        WRITE_PERI_REG(I2SINT_CLR, 0);
+        SET_PERI_REG_MASK(I2SINT_ENA, I2S_I2S_TX_REMPTY_INT_ENA);
+    }
+    WS2811_I2S_PROFILE_END(ctx, isr);
+}
+#elif WS2811_I2S_ENCODE_IN_ISR
 // Must be in IRAM, used by ISR.
 static void ws2811_i2s_fill(struct ws2811_i2s_context *ctx) {
-    while (!(READ_PERI_REG(I2SINT_RAW) & I2S_I2S_TX_WFULL_INT_RAW) && ctx->txlen) {
-        // Fill one byte, which becomes 24 bits. Place in MSB.
-        WRITE_PERI_REG(I2STXFIFO, ((uint32_t)NIBBLE_PWM[(*ctx->txbuf >> (ctx->txbit + 4)) & 0xF] << (32 - 12)) |
-                                      ((uint32_t)NIBBLE_PWM[(*ctx->txbuf >> ctx->txbit) & 0xF]) << (32 - 24));
+    while (ctx->txlen && !(READ_PERI_REG(I2SINT_RAW) & I2S_I2S_TX_WFULL_INT_RAW)) {
+        WRITE_PERI_REG(I2STXFIFO, ws2811_i2s_symbol(*ctx->txbuf >> ctx->txbit));
         ctx->txbit += 8;
         if (ctx->txbit == WS2811_I2S_BITS_PER_PIXEL) {
             ctx->txbit = 0;
@@ -78,7 +284,7 @@ static void ws2811_i2s_fill(struct ws2811_i2s_context *ctx) {
     if (ctx->txlen)
         return;
 
-    while (!(READ_PERI_REG(I2SINT_RAW) & I2S_I2S_TX_WFULL_INT_RAW) && ctx->trailer_len) {
+    while (ctx->trailer_len && !(READ_PERI_REG(I2SINT_RAW) & I2S_I2S_TX_WFULL_INT_RAW)) {
         WRITE_PERI_REG(I2STXFIFO, 0);
         --ctx->trailer_len;
     }
@@ -90,8 +296,60 @@ static void ws2811_i2s_fill(struct ws2811_i2s_context *ctx) {
     SET_PERI_REG_MASK(I2SINT_ENA, I2S_I2S_TX_REMPTY_INT_ENA);
     ctx->state = WS2811_I2S_STATE_RESET;
 }
+#else
+// Must be in IRAM, used by ISR.
+static void ws2811_i2s_fill(struct ws2811_i2s_context *ctx) {
+    const uint32_t *p = ctx->txbuf;
+    const uint32_t *end = p + ctx->txlen;
+    while (p != end && !(READ_PERI_REG(I2SINT_RAW) & I2S_I2S_TX_WFULL_INT_RAW)) {
+        WRITE_PERI_REG(I2STXFIFO, *p++);
+    }
+    ctx->txlen -= p - ctx->txbuf;
+    ctx->txbuf = p;
+
+    if (ctx->txlen)
+        return;
+
+    CLEAR_PERI_REG_MASK(I2SINT_ENA, I2S_I2S_TX_PUT_DATA_INT_ENA);
+    SET_PERI_REG_MASK(I2SINT_ENA, I2S_I2S_TX_REMPTY_INT_ENA);
+    ctx->state = WS2811_I2S_STATE_RESET;
+}
+#endif
+
+/**
+ * Latch the pending frame and start sending it.
+ *
+ * Must be called with the I2S interrupt masked, or from it. Must be in IRAM.
+ */
+static void ws2811_i2s_start(struct ws2811_i2s_context *ctx) {
+    ctx->front = !ctx->front;
+    ctx->pending = false;
+    ++ctx->latches;
+
+    struct ws2811_i2s_frame *frame = &ctx->frames[ctx->front];
+    ctx->txbuf = frame->samples;
+    ctx->txlen = frame->len;
+#if WS2811_I2S_ENCODE_IN_ISR
+    ctx->txbit = 0;
+    ctx->trailer_len = ws2811_i2s_trailer_len(frame->len);
+#endif
+    ctx->state = WS2811_I2S_STATE_SENDING;
+
+    CLEAR_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_START);
+    SET_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_RESET | I2S_I2S_TX_FIFO_RESET);
+    CLEAR_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_RESET | I2S_I2S_TX_FIFO_RESET);
+#if WS2811_I2S_USE_DMA
+    WRITE_PERI_REG(I2SINT_ENA, 0);
+    ws2811_i2s_dma_start(frame);
+#else
+    WRITE_PERI_REG(I2SINT_ENA, I2S_I2S_TX_PUT_DATA_INT_ENA);
+    ws2811_i2s_fill(ctx);
+#endif
+    WRITE_PERI_REG(I2SINT_CLR, 0xFFFFFFFF);
+    WRITE_PERI_REG(I2SINT_CLR, 0);
+    SET_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_START);
+}
 
-#define GPIO2_TOGGLE GPIO_OUTPUT_SET(2, (gpio2 = ~gpio2) & 1)
 static void ws2811_i2s_intr(void *cookie) {
     uint32_t int_st = READ_PERI_REG(WS2811_SPI_INT_ST);
 
@@ -103,20 +361,40 @@ static void ws2811_i2s_intr(void *cookie) {
     }
     if (int_st & WS2811_SPI_INT_ST_I2S) {
         struct ws2811_i2s_context *ctx = (struct ws2811_i2s_context *)cookie;
+        WS2811_I2S_PROFILE_START(ctx);
         switch (ctx->state) {
+#if !WS2811_I2S_USE_DMA
         case WS2811_I2S_STATE_SENDING:
+#if WS2811_I2S_PROFILE
+            // The status is cleared after every fill, so this means we were late.
+            if (READ_PERI_REG(I2SINT_RAW) & I2S_I2S_TX_REMPTY_INT_RAW)
+                ++ctx->prof.underruns;
+#endif
             ws2811_i2s_fill(ctx);
             break;
+#endif
 
         case WS2811_I2S_STATE_RESET:
             CLEAR_PERI_REG_MASK(I2SINT_ENA, I2S_I2S_TX_REMPTY_INT_ENA);
             CLEAR_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_START);
-            ctx->state = WS2811_I2S_STATE_IDLE;
+#if WS2811_I2S_USE_DMA
+            SET_PERI_REG_MASK(SLC_RX_LINK, SLC_RXLINK_STOP);
+#endif
+            WS2811_I2S_PROFILE_FRAME_DONE(ctx);
+            if (ctx->pending) {
+                // The reset time has passed, so we can go straight on to the next frame.
+                ws2811_i2s_start(ctx);
+            } else {
+                ctx->state = WS2811_I2S_STATE_IDLE;
+            }
+            if (ctx->frame_done_cb)
+                ctx->frame_done_cb(ctx->frame_done_arg);
             break;
         }
 
         WRITE_PERI_REG(I2SINT_CLR, 0xFFFFFFFF);
         WRITE_PERI_REG(I2SINT_CLR, 0);
+        WS2811_I2S_PROFILE_END(ctx, isr);
     }
 }
 
@@ -130,13 +408,34 @@ int ICACHE_FLASH_ATTR ws2811_i2s_init(struct ws2811_i2s_context *ctx) {
     WRITE_PERI_REG(I2SINT_ENA, 0);
     ETS_SPI_INTR_ENABLE();
 
+#if WS2811_I2S_USE_DMA
+    ets_isr_mask(1 << ETS_SLC_INUM);
+    ets_isr_attach(ETS_SLC_INUM, ws2811_i2s_slc_intr, ctx);
+    SET_PERI_REG_MASK(SLC_CONF0, SLC_RXLINK_RST | SLC_TXLINK_RST);
+    CLEAR_PERI_REG_MASK(SLC_CONF0, SLC_RXLINK_RST | SLC_TXLINK_RST);
+    CLEAR_PERI_REG_MASK(SLC_CONF0, SLC_MODE << SLC_MODE_S);
+    SET_PERI_REG_MASK(SLC_CONF0, 1 << SLC_MODE_S);
+    SET_PERI_REG_MASK(SLC_RX_DSCR_CONF, SLC_INFOR_NO_REPLACE | SLC_TOKEN_NO_REPLACE);
+    CLEAR_PERI_REG_MASK(SLC_RX_DSCR_CONF, SLC_RX_FILL_EN | SLC_RX_EOF_MODE | SLC_RX_FILL_MODE);
+    // The TX link is unused, but must point to a valid descriptor.
+    CLEAR_PERI_REG_MASK(SLC_TX_LINK, SLC_TXLINK_DESCADDR_MASK);
+    SET_PERI_REG_MASK(SLC_TX_LINK, ((uint32_t)ctx->frames[0].descs) & SLC_TXLINK_DESCADDR_MASK);
+    WRITE_PERI_REG(SLC_INT_CLR, 0xFFFFFFFF);
+    WRITE_PERI_REG(SLC_INT_ENA, SLC_RX_EOF_INT_ENA);
+    ets_isr_unmask(1 << ETS_SLC_INUM);
+#endif
+
     WRITE_PERI_REG(I2SCONF, I2S_I2S_RESET_MASK);
     WRITE_PERI_REG(I2SCONF,
                    (WS2811_I2S_BCK << I2S_BCK_DIV_NUM_S) | (WS2811_I2S_CLKM << I2S_CLKM_DIV_NUM_S) |
                        (8 << I2S_BITS_MOD_S)); // 16+I2S_BITS_MOD
 
 #define FIFO_MODE (WS2811_I2S_TX_FIFO_MOD_24BIT_DISCONT_DUAL << I2S_I2S_TX_FIFO_MOD_S) | (32 << I2S_I2S_TX_DATA_NUM_S)
+#if WS2811_I2S_USE_DMA
+    WRITE_PERI_REG(I2S_FIFO_CONF, FIFO_MODE | I2S_I2S_DSCR_EN);
+#else
     WRITE_PERI_REG(I2S_FIFO_CONF, FIFO_MODE);
+#endif
     WRITE_PERI_REG(I2SCONF_CHAN, (WS2811_I2S_TX_CHAN_DUAL << I2S_TX_CHAN_MOD_S));
 
     bbpll_set_i2s_clock(true);
@@ -144,40 +443,36 @@ int ICACHE_FLASH_ATTR ws2811_i2s_init(struct ws2811_i2s_context *ctx) {
     return 0;
 }
 
-void ICACHE_FLASH_ATTR ws2811_i2s_send(struct ws2811_i2s_context *ctx, const uint32_t *buf, size_t len) {
-    if (ws2811_i2s_is_sending(ctx))
-        return;
-
+void ICACHE_FLASH_ATTR ws2811_i2s_commit(struct ws2811_i2s_context *ctx, size_t len) {
     if (!len)
         return;
 
-    ctx->txbuf = buf;
-    ctx->txlen = len;
-    ctx->txbit = 0;
-#define FRAME_TIME (2 * 8 * WS2811_I2S_TBIT)
-#define REMPTY_DELAY_FRAMES (2 - 1)
-    // The precision of os_timer_arm_us is 500 µs, which is much higher than TBIT.
-    // We continue filling the FIFO with zero instead, giving us better precision.
-    // We need to write at least one frame to ensure the last data byte isn't repeating.
-    // The REMPTY interrupt comes two frames early, but since the hardware starts each transfer with one zero frame,
-    // we can discount one.
-    // The trailer length is in samples.
-    ctx->trailer_len = 2 * ((WS2811_I2S_TRES + FRAME_TIME - 1) / FRAME_TIME + REMPTY_DELAY_FRAMES);
-#undef FRAME_TIME
-    // The total output must be even since we have two channels.
-    if ((WS2811_I2S_BITS_PER_PIXEL / 8 * ctx->txlen + ctx->trailer_len) & 1)
-        ++ctx->trailer_len;
+    if (len > WS2811_I2S_MAX_PIXELS)
+        len = WS2811_I2S_MAX_PIXELS;
 
-    ctx->state = WS2811_I2S_STATE_SENDING;
+    // Withdraw any pending frame, so the interrupt handler doesn't latch it while we overwrite it.
+    // From here on, every earlier commit has either been latched or superseded.
+    ctx->pending = false;
+    ctx->superseded_frames = ctx->commits - ctx->latches;
+
+    struct ws2811_i2s_frame *frame = &ctx->frames[!ctx->front];
+    ws2811_i2s_encode(ctx, frame, ctx->pixels, len);
+#if WS2811_I2S_USE_DMA
+    ws2811_i2s_dma_link(frame);
+#endif
+    ++ctx->commits;
 
     ETS_SPI_INTR_DISABLE();
-    CLEAR_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_START);
-    SET_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_RESET | I2S_I2S_TX_FIFO_RESET);
-    CLEAR_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_RESET | I2S_I2S_TX_FIFO_RESET);
-    WRITE_PERI_REG(I2SINT_ENA, I2S_I2S_TX_PUT_DATA_INT_ENA);
-    ws2811_i2s_fill(ctx);
-    WRITE_PERI_REG(I2SINT_CLR, 0xFFFFFFFF);
-    WRITE_PERI_REG(I2SINT_CLR, 0);
-    SET_PERI_REG_MASK(I2SCONF, I2S_I2S_TX_START);
+    ctx->pending = true;
+    if (!ws2811_i2s_is_sending(ctx))
+        ws2811_i2s_start(ctx);
     ETS_SPI_INTR_ENABLE();
 }
+
+void ICACHE_FLASH_ATTR ws2811_i2s_send(struct ws2811_i2s_context *ctx, const uint32_t *buf, size_t len) {
+    if (len > WS2811_I2S_MAX_PIXELS)
+        len = WS2811_I2S_MAX_PIXELS;
+
+    os_memcpy(ctx->pixels, buf, len * sizeof(*buf));
+    ws2811_i2s_commit(ctx, len);
+}
@@ -3,6 +3,9 @@
 
 #include <user_interface.h>
 
+#include "cycle-prof.h"
+#include "ws2811-esp8266-grade.h"
+
 /* --- Macros --- */
 #ifndef WS2811_I2S_MAX_NUM_CONTEXTS
 /**
@@ -25,6 +28,79 @@
  */
 #define WS2811_I2S_BIT_ORDER WS2811_I2S_MSBF
 #endif
+#ifndef WS2811_I2S_USE_DMA
+/**
+ * Whether to feed the I2S FIFO from the SLC DMA engine instead of from the CPU in the I2S interrupt.
+ *
+ * With DMA, the only interrupts per frame are the end-of-data and FIFO-empty ones.
+ */
+#define WS2811_I2S_USE_DMA 0
+#endif
+#ifndef WS2811_I2S_MAX_PIXELS
+/**
+ * The maximum number of pixels that can be sent in one frame.
+ *
+ * The frame is encoded into context memory before sending. Costs WS2811_I2S_BITS_PER_PIXEL / 2 bytes per pixel.
+ */
+#define WS2811_I2S_MAX_PIXELS 120
+#endif
+#define WS2811_I2S_LUT_NIBBLE 1
+#define WS2811_I2S_LUT_BYTE 2
+#ifndef WS2811_I2S_LUT
+/**
+ * The encoder lookup table. A byte table needs one lookup per colour byte, but uses 1 kB instead of 32 bytes.
+ */
+#define WS2811_I2S_LUT WS2811_I2S_LUT_BYTE
+#endif
+#ifndef WS2811_I2S_LUT_IN_FLASH
+/**
+ * Whether to place the encoder lookup table in flash instead of DRAM. Flash reads are slower, but free up RAM.
+ */
+#define WS2811_I2S_LUT_IN_FLASH 0
+#endif
+/**
+ * The number of bytes of DRAM used by the encoder lookup table.
+ */
+#if WS2811_I2S_LUT_IN_FLASH
+#define WS2811_I2S_LUT_RAM_SIZE 0
+#elif WS2811_I2S_LUT == WS2811_I2S_LUT_BYTE
+#define WS2811_I2S_LUT_RAM_SIZE (256 * 4)
+#else
+#define WS2811_I2S_LUT_RAM_SIZE (16 * 2)
+#endif
+#ifndef WS2811_I2S_ENCODE_IN_ISR
+/**
+ * Whether to encode in the FIFO interrupt handler, as the driver used to, instead of in ws2811_i2s_commit. This keeps
+ * the old path for comparing interrupt times, e.g. in test/i2s_sim. Needs FIFO mode and the lookup table in RAM.
+ */
+#define WS2811_I2S_ENCODE_IN_ISR 0
+#endif
+#ifndef WS2811_I2S_GRADE
+/**
+ * Whether the encoder can grade pixels as it goes. See ws2811_i2s_set_grade.
+ *
+ * Costs WS2811_GRADE_CHANNELS bytes of dither residuals per pixel.
+ */
+#define WS2811_I2S_GRADE 1
+#endif
+#ifndef WS2811_I2S_PROFILE
+/**
+ * Whether to measure the interrupt handlers and the encoder. See struct ws2811_i2s_profile.
+ */
+#define WS2811_I2S_PROFILE CYCLE_PROF
+#endif
+/**
+ * The maximum reset trailer length, in samples.
+ */
+#define WS2811_I2S_MAX_TRAILER_LEN 16
+/**
+ * The number of 32-bit I2S samples needed for a full frame, including the trailer.
+ */
+#define WS2811_I2S_MAX_SAMPLES (WS2811_I2S_MAX_PIXELS * WS2811_I2S_BITS_PER_PIXEL / 8 + WS2811_I2S_MAX_TRAILER_LEN)
+/**
+ * The number of DMA descriptors needed for a full frame. Each descriptor holds up to 4092 bytes of samples.
+ */
+#define WS2811_I2S_MAX_DMA_DESCS ((WS2811_I2S_MAX_SAMPLES + 1023 - 1) / 1023)
 
 /* --- Types --- */
 typedef enum {
@@ -35,12 +111,67 @@ typedef enum {
     WS2811_I2S_STATE_RESET,
 } ws2811_i2s_state;
 
+/**
+ * An SLC DMA descriptor. The layout is defined by hardware.
+ */
+struct ws2811_i2s_dma_desc {
+    uint32_t blocksize : 12;
+    uint32_t datalen : 12;
+    uint32_t unused : 5;
+    uint32_t sub_sof : 1;
+    uint32_t eof : 1;
+    uint32_t owner : 1; // Set while owned by hardware
+    const uint32_t *buf;
+    struct ws2811_i2s_dma_desc *next;
+};
+
+/**
+ * Only updated if WS2811_I2S_PROFILE is set. The caller may reset them at any time.
+ */
+struct ws2811_i2s_profile {
+    struct cycle_prof isr;
+    struct cycle_prof encode;
+    uint32_t underruns; // Times the FIFO reached its empty mark before the frame was written. FIFO mode only.
+    uint32_t frames;
+    uint32_t max_frame_isrs;   // The most interrupts needed to send one frame
+    uint32_t frame_start_isrs; // isr.count when the current frame started
+};
+
+/**
+ * An encoded frame, ready to be sent. With WS2811_I2S_ENCODE_IN_ISR, it holds graded pixels instead.
+ */
+struct ws2811_i2s_frame {
+    uint32_t samples[WS2811_I2S_MAX_SAMPLES];
+    int len; // Number of samples, or pixels
+#if WS2811_I2S_USE_DMA
+    struct ws2811_i2s_dma_desc descs[WS2811_I2S_MAX_DMA_DESCS];
+#endif
+};
+
 struct ws2811_i2s_context {
-    ws2811_i2s_state state;
-    const uint32_t *txbuf;
-    int txlen;
-    int txbit;
-    int trailer_len; // Number of samples
+    volatile ws2811_i2s_state state;
+    const uint32_t *txbuf; // Next sample to send
+    int txlen;             // Number of samples left, or pixels with WS2811_I2S_ENCODE_IN_ISR
+#if WS2811_I2S_ENCODE_IN_ISR
+    uint8_t txbit;   // Next byte of the pixel at txbuf, in bits
+    int trailer_len; // Number of zero samples left
+#endif
+    uint32_t pixels[WS2811_I2S_MAX_PIXELS]; // The back buffer
+    struct ws2811_i2s_frame frames[2];
+    volatile uint8_t front; // The frame being sent, or last sent
+    volatile bool pending;  // Whether the other frame is waiting to be sent
+    uint32_t commits;
+    volatile uint32_t latches;
+    uint32_t superseded_frames; // Number of committed frames that were replaced before being sent
+    void (*frame_done_cb)(void *arg);
+    void *frame_done_arg;
+#if WS2811_I2S_GRADE
+    const struct ws2811_grade *grade;
+    uint8_t residual[WS2811_I2S_MAX_PIXELS * WS2811_GRADE_CHANNELS]; // Dither residuals
+#endif
+#if WS2811_I2S_PROFILE
+    struct ws2811_i2s_profile prof;
+#endif
 };
 
 /* --- Functions --- */
@@ -54,17 +185,65 @@ struct ws2811_i2s_context {
  */
 extern int ICACHE_FLASH_ATTR ws2811_i2s_init(struct ws2811_i2s_context *ctx);
 
+/**
+ * Return the back buffer, which holds WS2811_I2S_MAX_PIXELS pixels.
+ *
+ * Render into this, and call ws2811_i2s_commit. The buffer is never sent directly, so it can be modified at any time.
+ * Only the lower WS2811_I2S_BITS_PER_PIXEL bits of each pixel are sent.
+ */
+static inline uint32_t *ws2811_i2s_back_buffer(struct ws2811_i2s_context *ctx) { return ctx->pixels; }
+
+/**
+ * Encode the back buffer and queue it for sending.
+ *
+ * If the context is idle, sending starts immediately. Otherwise, the frame is sent as soon as the current one is done.
+ * If another frame was already waiting, it is dropped in favour of this one, and counted in superseded_frames.
+ *
+ * @param ctx The context of the bus to send to.
+ * @param len The number of pixels to send. At most WS2811_I2S_MAX_PIXELS pixels are sent.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_i2s_commit(struct ws2811_i2s_context *ctx, size_t len);
+
 /**
  * Send a buffer of pixel data.
  *
- * If the context is already sending data, this function does nothing.
+ * Copies buf to the back buffer and commits it. See ws2811_i2s_commit.
  *
  * @param ctx The context of the bus to send to.
- * @param buf The pixel buffer to send. Only the lower WS2811_BITS_PER_PIXEL bits are sent.
+ * @param buf The pixel buffer to send. Only the lower WS2811_I2S_BITS_PER_PIXEL bits are sent.
  * @param len The length of buf, in pixels.
  */
 extern void ICACHE_FLASH_ATTR ws2811_i2s_send(struct ws2811_i2s_context *ctx, const uint32_t *buf, size_t len);
 
+/**
+ * Set a function to call every time a frame has been sent, including the reset time.
+ *
+ * The next pending frame, if any, has already started when this is called. Since it is called from the interrupt
+ * handler, the function must be in IRAM and should do little more than system_os_post.
+ *
+ * @param ctx The context of the bus.
+ * @param cb The function to call, or NULL.
+ * @param arg The argument to pass to cb.
+ */
+static inline void ws2811_i2s_set_frame_done_cb(struct ws2811_i2s_context *ctx, void (*cb)(void *), void *arg) {
+    ctx->frame_done_cb = cb;
+    ctx->frame_done_arg = arg;
+}
+
+#if WS2811_I2S_GRADE
+/**
+ * Set the colour grading to apply while encoding, so it costs no extra pass over the pixels.
+ *
+ * The back buffer is left as rendered.
+ *
+ * @param ctx The context of the bus.
+ * @param grade The grading, or NULL to send pixels as they are. Must outlive the context.
+ */
+static inline void ws2811_i2s_set_grade(struct ws2811_i2s_context *ctx, const struct ws2811_grade *grade) {
+    ctx->grade = grade;
+}
+#endif
+
 /**
  * Return whether the context is currently sending data.
  */
@@ -0,0 +1,217 @@
+/**
+ * WS2811/WS2812 driver using the HSPI hardware.
+ *
+ * Only MOSI is used. Each colour byte is encoded into one 32-bit SPI word in ws2811_spi_commit, so the interrupt
+ * handler only copies up to 16 words into the W0-W15 buffer and starts the next transaction. There are two word
+ * buffers. The interrupt handler latches a committed frame when the previous one has been sent.
+ *
+ * Unlike I2S, SPI has no FIFO that can be topped up while sending, so there is a short gap between transactions. It
+ * falls at the end of a bit, where the line is low anyway.
+ */
+#include "ws2811-esp8266-spi.h"
+
+#include <eagle_soc.h>
+#include <ets_sys.h>
+#include <osapi.h>
+
+#include "spi_register.h"
+
+/* --- Macros --- */
+#define WS2811_SPI_HSPI 1
+#define WS2811_SPI_TRES 50000 // ns
+// 80 MHz / (5 * 5) = 3.2 MHz, or 312.5 ns per SPI bit.
+#define WS2811_SPI_CLKDIV_PRE 5
+#define WS2811_SPI_CLKCNT_N 5
+#define WS2811_SPI_BUF_WORDS 16 // W0-W15
+
+// Check the resulting wire timing against the WS2812B datasheet (doc/ws2812b.pdf), which allows ±150 ns on each.
+// One SPI bit is T0H and T1L, and three are T1H and T0L.
+#define WS2811_SPI_TSYMBOL (WS2811_SPI_CLKDIV_PRE * WS2811_SPI_CLKCNT_N * 1000 / (APB_CLK_FREQ / 1000000)) // ns
+#define WS2811_SPI_IN_SPEC(t, nominal) ((t) + 150 >= (nominal) && (t) <= (nominal) + 150)
+#if !WS2811_SPI_IN_SPEC(WS2811_SPI_TSYMBOL, 400) || !WS2811_SPI_IN_SPEC(3 * WS2811_SPI_TSYMBOL, 800) ||             \
+    !WS2811_SPI_IN_SPEC(3 * WS2811_SPI_TSYMBOL, 850) || !WS2811_SPI_IN_SPEC(WS2811_SPI_TSYMBOL, 450)
+#error "The SPI bit timing is outside the WS2812B datasheet limits"
+#endif
+
+#define WS2811_SPI_WORD_TIME (32 * WS2811_SPI_CLKDIV_PRE * WS2811_SPI_CLKCNT_N * 1000 / (APB_CLK_FREQ / 1000000)) // ns
+// The trailer length is in words.
+#define WS2811_SPI_TRAILER_LEN ((WS2811_SPI_TRES + WS2811_SPI_WORD_TIME - 1) / WS2811_SPI_WORD_TIME)
+#if WS2811_SPI_TRAILER_LEN > WS2811_SPI_MAX_TRAILER_LEN
+#error "WS2811_SPI_MAX_TRAILER_LEN is too small for the reset time"
+#endif
+
+#define WS2811_SPI_INT_ST (PERIPHS_DPORT_BASEADDR | 0x20)
+#define WS2811_SPI_INT_ST_HSPI BIT7
+
+#if WS2811_SPI_PROFILE
+#define WS2811_SPI_PROFILE_START(ctx) uint32_t prof_start = cycle_prof_ccount()
+#define WS2811_SPI_PROFILE_END(ctx, what) cycle_prof_add(&(ctx)->prof.what, cycle_prof_ccount() - prof_start)
+#else
+#define WS2811_SPI_PROFILE_START(ctx)
+#define WS2811_SPI_PROFILE_END(ctx, what)
+#endif
+
+/* --- Functions --- */
+extern void ets_isr_attach(int, void (*)(void *), void *);
+extern void ets_isr_mask(uint32_t);
+extern void ets_isr_unmask(uint32_t);
+extern void ets_memset(void *, uint8_t, int);
+
+/* --- Data --- */
+#define SPI_BIT(b) ((b) ? 0xE : 0x8)
+#define SPI_NIBBLE(v) ((SPI_BIT((v)&8) << 12) | (SPI_BIT((v)&4) << 8) | (SPI_BIT((v)&2) << 4) | SPI_BIT((v)&1))
+/**
+ * The SPI word for each byte value. Only used in task context, and all loads are aligned, so it can live in flash.
+ */
+static const uint32_t BYTE_SPI[] ICACHE_RODATA_ATTR = {
+#define SPI_BYTE(v) (((uint32_t)SPI_NIBBLE((v) >> 4) << 16) | SPI_NIBBLE((v)&0xF))
+#define SPI_BYTE4(v) SPI_BYTE(v), SPI_BYTE((v) + 1), SPI_BYTE((v) + 2), SPI_BYTE((v) + 3)
+#define SPI_BYTE16(v) SPI_BYTE4(v), SPI_BYTE4((v) + 4), SPI_BYTE4((v) + 8), SPI_BYTE4((v) + 12)
+#define SPI_BYTE64(v) SPI_BYTE16(v), SPI_BYTE16((v) + 16), SPI_BYTE16((v) + 32), SPI_BYTE16((v) + 48)
+    SPI_BYTE64(0), SPI_BYTE64(64), SPI_BYTE64(128), SPI_BYTE64(192),
+#undef SPI_BYTE64
+#undef SPI_BYTE16
+#undef SPI_BYTE4
+#undef SPI_BYTE
+};
+#undef SPI_NIBBLE
+#undef SPI_BIT
+
+/**
+ * Encode the pixels and the reset trailer into SPI words.
+ *
+ * Runs in task context, so it doesn't need to be in IRAM.
+ */
+static void ICACHE_FLASH_ATTR ws2811_spi_encode(struct ws2811_spi_context *ctx, struct ws2811_spi_frame *frame,
+                                                const uint32_t *buf, size_t len) {
+    WS2811_SPI_PROFILE_START(ctx);
+    uint32_t *wp = frame->words;
+    for (const uint32_t *end = buf + len; buf != end; ++buf) {
+        for (int bit = WS2811_SPI_BITS_PER_PIXEL - 8; bit >= 0; bit -= 8) {
+            *wp++ = BYTE_SPI[(*buf >> bit) & 0xFF];
+        }
+    }
+    for (int i = 0; i < WS2811_SPI_TRAILER_LEN; ++i) {
+        *wp++ = 0;
+    }
+
+    frame->len = wp - frame->words;
+    WS2811_SPI_PROFILE_END(ctx, encode);
+}
+
+/**
+ * Load the next words into the SPI buffer and start the transaction.
+ *
+ * Must be in IRAM, used by ISR.
+ */
+static void ws2811_spi_fill(struct ws2811_spi_context *ctx) {
+    int n = (ctx->txlen > WS2811_SPI_BUF_WORDS ? WS2811_SPI_BUF_WORDS : ctx->txlen);
+    for (int i = 0; i < n; ++i) {
+        WRITE_PERI_REG(SPI_W0(WS2811_SPI_HSPI) + 4 * i, ctx->txbuf[i]);
+    }
+    ctx->txbuf += n;
+    ctx->txlen -= n;
+
+    WRITE_PERI_REG(SPI_USER1(WS2811_SPI_HSPI), ((n * 32 - 1) & SPI_USR_MOSI_BITLEN) << SPI_USR_MOSI_BITLEN_S);
+    SET_PERI_REG_MASK(SPI_CMD(WS2811_SPI_HSPI), SPI_USR);
+}
+
+/**
+ * Latch the pending frame and start sending it.
+ *
+ * Must be called with the SPI interrupt masked, or from it. Must be in IRAM.
+ */
+static void ws2811_spi_start(struct ws2811_spi_context *ctx) {
+    ctx->front = !ctx->front;
+    ctx->pending = false;
+    ++ctx->latches;
+
+    struct ws2811_spi_frame *frame = &ctx->frames[ctx->front];
+    ctx->txbuf = frame->words;
+    ctx->txlen = frame->len;
+    ctx->state = WS2811_SPI_STATE_SENDING;
+
+    ws2811_spi_fill(ctx);
+}
+
+static void ws2811_spi_intr(void *cookie) {
+    uint32_t int_st = READ_PERI_REG(WS2811_SPI_INT_ST);
+
+    if (int_st & BIT4) {
+        CLEAR_PERI_REG_MASK(SPI_SLAVE(0), 0x3FF);
+    }
+    if (int_st & WS2811_SPI_INT_ST_HSPI) {
+        struct ws2811_spi_context *ctx = (struct ws2811_spi_context *)cookie;
+        WS2811_SPI_PROFILE_START(ctx);
+        CLEAR_PERI_REG_MASK(SPI_SLAVE(WS2811_SPI_HSPI), SPI_TRANS_DONE);
+
+        if (ctx->state == WS2811_SPI_STATE_SENDING) {
+            if (ctx->txlen) {
+                ws2811_spi_fill(ctx);
+            } else {
+                // The trailer has been sent.
+                if (ctx->pending) {
+                    ws2811_spi_start(ctx);
+                } else {
+                    ctx->state = WS2811_SPI_STATE_IDLE;
+                }
+                if (ctx->frame_done_cb)
+                    ctx->frame_done_cb(ctx->frame_done_arg);
+            }
+        }
+        WS2811_SPI_PROFILE_END(ctx, isr);
+    }
+}
+
+int ICACHE_FLASH_ATTR ws2811_spi_init(struct ws2811_spi_context *ctx) {
+    os_memset(ctx, 0, sizeof(*ctx));
+
+    ETS_SPI_INTR_DISABLE();
+    ETS_SPI_INTR_ATTACH(ws2811_spi_intr, ctx);
+
+    // MSB first, plain single-bit output.
+    WRITE_PERI_REG(SPI_CTRL(WS2811_SPI_HSPI), 0);
+    WRITE_PERI_REG(SPI_CLOCK(WS2811_SPI_HSPI),
+                   ((WS2811_SPI_CLKDIV_PRE - 1) << SPI_CLKDIV_PRE_S) | ((WS2811_SPI_CLKCNT_N - 1) << SPI_CLKCNT_N_S) |
+                       ((WS2811_SPI_CLKCNT_N / 2 - 1) << SPI_CLKCNT_H_S) |
+                       ((WS2811_SPI_CLKCNT_N - 1) << SPI_CLKCNT_L_S));
+    // Send each word MSB first, so the first colour bit is in bit 31.
+    WRITE_PERI_REG(SPI_USER(WS2811_SPI_HSPI), SPI_USR_MOSI | SPI_WR_BYTE_ORDER);
+
+    CLEAR_PERI_REG_MASK(SPI_SLAVE(0), 0x3FF);
+    CLEAR_PERI_REG_MASK(SPI_SLAVE(WS2811_SPI_HSPI), 0x3FF);
+    SET_PERI_REG_MASK(SPI_SLAVE(WS2811_SPI_HSPI), SPI_TRANS_DONE_EN);
+    ETS_SPI_INTR_ENABLE();
+
+    return 0;
+}
+
+void ICACHE_FLASH_ATTR ws2811_spi_commit(struct ws2811_spi_context *ctx, size_t len) {
+    if (!len)
+        return;
+
+    if (len > WS2811_SPI_MAX_PIXELS)
+        len = WS2811_SPI_MAX_PIXELS;
+
+    // Withdraw any pending frame, so the interrupt handler doesn't latch it while we overwrite it.
+    // From here on, every earlier commit has either been latched or superseded.
+    ctx->pending = false;
+    ctx->superseded_frames = ctx->commits - ctx->latches;
+
+    ws2811_spi_encode(ctx, &ctx->frames[!ctx->front], ctx->pixels, len);
+    ++ctx->commits;
+
+    ETS_SPI_INTR_DISABLE();
+    ctx->pending = true;
+    if (!ws2811_spi_is_sending(ctx))
+        ws2811_spi_start(ctx);
+    ETS_SPI_INTR_ENABLE();
+}
+
+void ICACHE_FLASH_ATTR ws2811_spi_send(struct ws2811_spi_context *ctx, const uint32_t *buf, size_t len) {
+    if (len > WS2811_SPI_MAX_PIXELS)
+        len = WS2811_SPI_MAX_PIXELS;
+
+    os_memcpy(ctx->pixels, buf, len * sizeof(*buf));
+    ws2811_spi_commit(ctx, len);
+}
@@ -0,0 +1,147 @@
+#ifndef WS2811_ESP8266_SPI_H_
+#define WS2811_ESP8266_SPI_H_
+
+#include <user_interface.h>
+
+#include "cycle-prof.h"
+
+/* --- Macros --- */
+#ifndef WS2811_SPI_BITS_PER_PIXEL
+/**
+ * Number of bits per LED unit. Normally 24 (8-bit RGB).
+ * Must be a multiple of eight. Sent MSB first.
+ */
+#define WS2811_SPI_BITS_PER_PIXEL 24
+#endif
+#ifndef WS2811_SPI_MAX_PIXELS
+/**
+ * The maximum number of pixels that can be sent in one frame.
+ *
+ * The frame is encoded into context memory before sending. Costs WS2811_SPI_BITS_PER_PIXEL bytes per pixel.
+ */
+#define WS2811_SPI_MAX_PIXELS 120
+#endif
+#ifndef WS2811_SPI_PROFILE
+/**
+ * Whether to measure the interrupt handler and the encoder. See struct ws2811_spi_profile.
+ */
+#define WS2811_SPI_PROFILE CYCLE_PROF
+#endif
+/**
+ * The maximum reset trailer length, in words.
+ */
+#define WS2811_SPI_MAX_TRAILER_LEN 8
+/**
+ * The number of 32-bit SPI words needed for a full frame, including the trailer. One colour byte becomes one word.
+ */
+#define WS2811_SPI_MAX_WORDS (WS2811_SPI_MAX_PIXELS * WS2811_SPI_BITS_PER_PIXEL / 8 + WS2811_SPI_MAX_TRAILER_LEN)
+
+/* --- Types --- */
+typedef enum {
+    WS2811_SPI_STATE_IDLE,
+    WS2811_SPI_STATE_SENDING,
+} ws2811_spi_state;
+
+/**
+ * Only updated if WS2811_SPI_PROFILE is set. The caller may reset them at any time.
+ */
+struct ws2811_spi_profile {
+    struct cycle_prof isr;
+    struct cycle_prof encode;
+};
+
+/**
+ * An encoded frame, ready to be sent.
+ */
+struct ws2811_spi_frame {
+    uint32_t words[WS2811_SPI_MAX_WORDS];
+    int len; // Number of words
+};
+
+struct ws2811_spi_context {
+    volatile ws2811_spi_state state;
+    const uint32_t *txbuf;                  // Next word to send
+    int txlen;                              // Number of words left
+    uint32_t pixels[WS2811_SPI_MAX_PIXELS]; // The back buffer
+    struct ws2811_spi_frame frames[2];
+    volatile uint8_t front; // The frame being sent, or last sent
+    volatile bool pending;  // Whether the other frame is waiting to be sent
+    uint32_t commits;
+    volatile uint32_t latches;
+    uint32_t superseded_frames; // Number of committed frames that were replaced before being sent
+    void (*frame_done_cb)(void *arg);
+    void *frame_done_arg;
+#if WS2811_SPI_PROFILE
+    struct ws2811_spi_profile prof;
+#endif
+};
+
+/* --- Functions --- */
+/**
+ * Initialize a new WS2811 LED bus context on the HSPI MOSI pin (GPIO13).
+ *
+ * This sets up the SPI module and the interrupt routine. The pin mux must be set up already (FUNC_HSPID_MOSI).
+ *
+ * Each WS2811 bit is sent as four SPI bits at 3.2 MHz: 1000 for zero, and 1110 for one. The frame is streamed through
+ * the 64-byte W0-W15 buffer, which is refilled from the transaction-done interrupt. The line stays low between
+ * transactions, which stretches the low part of a bit by the interrupt latency. LEDs tolerate several microseconds of
+ * that, but a much longer delay is taken as a reset.
+ *
+ * The SPI interrupt is shared with I2S, so this can't be used together with the I2S driver.
+ *
+ * @param ctx The context to be initialized.
+ * @return Zero on success.
+ */
+extern int ICACHE_FLASH_ATTR ws2811_spi_init(struct ws2811_spi_context *ctx);
+
+/**
+ * Return the back buffer, which holds WS2811_SPI_MAX_PIXELS pixels.
+ *
+ * Render into this, and call ws2811_spi_commit. The buffer is never sent directly, so it can be modified at any time.
+ * Only the lower WS2811_SPI_BITS_PER_PIXEL bits of each pixel are sent.
+ */
+static inline uint32_t *ws2811_spi_back_buffer(struct ws2811_spi_context *ctx) { return ctx->pixels; }
+
+/**
+ * Encode the back buffer and queue it for sending.
+ *
+ * If the context is idle, sending starts immediately. Otherwise, the frame is sent as soon as the current one is done.
+ * If another frame was already waiting, it is dropped in favour of this one, and counted in superseded_frames.
+ *
+ * @param ctx The context of the bus to send to.
+ * @param len The number of pixels to send. At most WS2811_SPI_MAX_PIXELS pixels are sent.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_spi_commit(struct ws2811_spi_context *ctx, size_t len);
+
+/**
+ * Send a buffer of pixel data.
+ *
+ * Copies buf to the back buffer and commits it. See ws2811_spi_commit.
+ *
+ * @param ctx The context of the bus to send to.
+ * @param buf The pixel buffer to send. Only the lower WS2811_SPI_BITS_PER_PIXEL bits are sent.
+ * @param len The length of buf, in pixels.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_spi_send(struct ws2811_spi_context *ctx, const uint32_t *buf, size_t len);
+
+/**
+ * Set a function to call every time a frame has been sent, including the reset time.
+ *
+ * The next pending frame, if any, has already started when this is called. Since it is called from the interrupt
+ * handler, the function must be in IRAM and should do little more than system_os_post.
+ *
+ * @param ctx The context of the bus.
+ * @param cb The function to call, or NULL.
+ * @param arg The argument to pass to cb.
+ */
+static inline void ws2811_spi_set_frame_done_cb(struct ws2811_spi_context *ctx, void (*cb)(void *), void *arg) {
+    ctx->frame_done_cb = cb;
+    ctx->frame_done_arg = arg;
+}
+
+/**
+ * Return whether the context is currently sending data.
+ */
+static inline bool ws2811_spi_is_sending(struct ws2811_spi_context *ctx) { return ctx->state != WS2811_SPI_STATE_IDLE; }
+
+#endif /* WS2811_ESP8266_SPI_H_ */
@@ -0,0 +1,267 @@
+/**
+ * WS2811/WS2812 driver using the UART1 transmitter.
+ *
+ * Each colour byte is encoded into four UART bytes in ws2811_uart_commit, so the interrupt handler only copies bytes
+ * into the TX FIFO. There are two byte buffers. The interrupt handler latches a committed frame when the previous one
+ * has been sent.
+ *
+ * The UART has no transmit-done interrupt, only FIFO-empty, which comes while the last byte is still being shifted
+ * out. The handler waits one byte time before touching the pin mux.
+ */
+#include "ws2811-esp8266-uart.h"
+
+#include <eagle_soc.h>
+#include <ets_sys.h>
+#include <osapi.h>
+
+#include "pin_mux_register.h"
+#include "uart_register.h"
+
+/* --- Macros --- */
+#define WS2811_UART_NUM 1
+#define WS2811_UART_GPIO 2
+#define WS2811_UART_TRES 50000 // ns
+#define WS2811_UART_BAUD 3200000
+#define WS2811_UART_BYTE_TIME (8 * 1000000 / (WS2811_UART_BAUD / 1000)) // ns
+// Refill when the FIFO has less than this many bytes, which lasts 80 µs.
+#define WS2811_UART_TXFIFO_THRHD 32
+// The reset is timed by sending this many bytes while the pin is disconnected.
+#define WS2811_UART_RESET_BYTES ((WS2811_UART_TRES + WS2811_UART_BYTE_TIME - 1) / WS2811_UART_BYTE_TIME)
+#if WS2811_UART_RESET_BYTES >= UART_FIFO_LEN
+#error "The reset doesn't fit in the UART FIFO"
+#endif
+
+// Check the resulting wire timing against the WS2812B datasheet (doc/ws2812b.pdf), which allows ±150 ns on each.
+// One UART bit is T0H and T1L, and three are T1H and T0L.
+#define WS2811_UART_TSYMBOL (1000000000 / WS2811_UART_BAUD) // ns
+#define WS2811_UART_IN_SPEC(t, nominal) ((t) + 150 >= (nominal) && (t) <= (nominal) + 150)
+#if !WS2811_UART_IN_SPEC(WS2811_UART_TSYMBOL, 400) || !WS2811_UART_IN_SPEC(3 * WS2811_UART_TSYMBOL, 800) ||         \
+    !WS2811_UART_IN_SPEC(3 * WS2811_UART_TSYMBOL, 850) || !WS2811_UART_IN_SPEC(WS2811_UART_TSYMBOL, 450)
+#error "The UART bit timing is outside the WS2812B datasheet limits"
+#endif
+
+#if WS2811_UART_PROFILE
+#define WS2811_UART_PROFILE_START(ctx) uint32_t prof_start = cycle_prof_ccount()
+#define WS2811_UART_PROFILE_END(ctx, what) cycle_prof_add(&(ctx)->prof.what, cycle_prof_ccount() - prof_start)
+#else
+#define WS2811_UART_PROFILE_START(ctx)
+#define WS2811_UART_PROFILE_END(ctx, what)
+#endif
+
+/* --- Functions --- */
+extern void ets_delay_us(uint32_t);
+extern void ets_isr_attach(int, void (*)(void *), void *);
+extern void ets_isr_mask(uint32_t);
+extern void ets_isr_unmask(uint32_t);
+extern void ets_memset(void *, uint8_t, int);
+
+/* --- Data --- */
+// Inverted 6N1 bytes for each pair of bits, first bit in the MSB of the index.
+#define UART_PAIR(v) ((v) == 0 ? 0x37 : (v) == 1 ? 0x07 : (v) == 2 ? 0x34 : 0x04)
+/**
+ * The four UART bytes for each colour byte, first in the LSB. Only used in task context, and all loads are aligned, so
+ * it can live in flash.
+ */
+static const uint32_t BYTE_UART[] ICACHE_RODATA_ATTR = {
+#define UART_BYTE(v)                                                                                                   \
+    (UART_PAIR(((v) >> 6) & 3) | (UART_PAIR(((v) >> 4) & 3) << 8) | (UART_PAIR(((v) >> 2) & 3) << 16) |             \
+     ((uint32_t)UART_PAIR((v)&3) << 24))
+#define UART_BYTE4(v) UART_BYTE(v), UART_BYTE((v) + 1), UART_BYTE((v) + 2), UART_BYTE((v) + 3)
+#define UART_BYTE16(v) UART_BYTE4(v), UART_BYTE4((v) + 4), UART_BYTE4((v) + 8), UART_BYTE4((v) + 12)
+#define UART_BYTE64(v) UART_BYTE16(v), UART_BYTE16((v) + 16), UART_BYTE16((v) + 32), UART_BYTE16((v) + 48)
+    UART_BYTE64(0), UART_BYTE64(64), UART_BYTE64(128), UART_BYTE64(192),
+#undef UART_BYTE64
+#undef UART_BYTE16
+#undef UART_BYTE4
+#undef UART_BYTE
+};
+#undef UART_PAIR
+
+/**
+ * Encode the pixels into UART bytes.
+ *
+ * Runs in task context, so it doesn't need to be in IRAM.
+ */
+static void ICACHE_FLASH_ATTR ws2811_uart_encode(struct ws2811_uart_context *ctx, struct ws2811_uart_frame *frame,
+                                                 const uint32_t *buf, size_t len) {
+    WS2811_UART_PROFILE_START(ctx);
+    uint32_t *wp = frame->bytes;
+    for (const uint32_t *end = buf + len; buf != end; ++buf) {
+        for (int bit = WS2811_UART_BITS_PER_PIXEL - 8; bit >= 0; bit -= 8) {
+            *wp++ = BYTE_UART[(*buf >> bit) & 0xFF];
+        }
+    }
+
+    frame->len = (wp - frame->bytes) * sizeof(*wp);
+    WS2811_UART_PROFILE_END(ctx, encode);
+}
+
+/**
+ * Set the FIFO level below which the FIFO-empty interrupt fires.
+ *
+ * Must be in IRAM, used by ISR.
+ */
+static inline void ws2811_uart_set_empty_thrhd(uint32_t n) {
+    uint32_t conf1 = READ_PERI_REG(UART_CONF1(WS2811_UART_NUM));
+    conf1 &= ~(UART_TXFIFO_EMPTY_THRHD << UART_TXFIFO_EMPTY_THRHD_S);
+    WRITE_PERI_REG(UART_CONF1(WS2811_UART_NUM), conf1 | (n << UART_TXFIFO_EMPTY_THRHD_S));
+}
+
+/**
+ * Top up the TX FIFO.
+ *
+ * Must be in IRAM, used by ISR.
+ */
+static void ws2811_uart_fill(struct ws2811_uart_context *ctx) {
+    uint32_t used = (READ_PERI_REG(UART_STATUS(WS2811_UART_NUM)) >> UART_TXFIFO_CNT_S) & UART_TXFIFO_CNT;
+    int n = UART_FIFO_LEN - 1 - used;
+    if (n > ctx->txlen)
+        n = ctx->txlen;
+
+    const uint8_t *p = ctx->txbuf;
+    for (const uint8_t *end = p + n; p != end; ++p) {
+        WRITE_PERI_REG(UART_FIFO(WS2811_UART_NUM), *p);
+    }
+    ctx->txbuf = p;
+    ctx->txlen -= n;
+
+    if (ctx->txlen)
+        return;
+
+    // Everything is queued. Wake up once the FIFO is empty.
+    ws2811_uart_set_empty_thrhd(1);
+    ctx->state = WS2811_UART_STATE_FINISH;
+}
+
+/**
+ * Latch the pending frame and start sending it. The pin must be connected to the UART.
+ *
+ * Must be called with the UART interrupt masked, or from it. Must be in IRAM.
+ */
+static void ws2811_uart_start(struct ws2811_uart_context *ctx) {
+    ctx->front = !ctx->front;
+    ctx->pending = false;
+    ++ctx->latches;
+
+    struct ws2811_uart_frame *frame = &ctx->frames[ctx->front];
+    ctx->txbuf = (const uint8_t *)frame->bytes;
+    ctx->txlen = frame->len;
+    ctx->state = WS2811_UART_STATE_SENDING;
+
+    ws2811_uart_set_empty_thrhd(WS2811_UART_TXFIFO_THRHD);
+    ws2811_uart_fill(ctx);
+    WRITE_PERI_REG(UART_INT_CLR(WS2811_UART_NUM), UART_TXFIFO_EMPTY_INT);
+    SET_PERI_REG_MASK(UART_INT_ENA(WS2811_UART_NUM), UART_TXFIFO_EMPTY_INT);
+}
+
+void ws2811_uart_intr(void *arg) {
+    uint32_t int_st = READ_PERI_REG(UART_INT_ST(WS2811_UART_NUM));
+    if (!(int_st & UART_TXFIFO_EMPTY_INT)) {
+        WRITE_PERI_REG(UART_INT_CLR(WS2811_UART_NUM), int_st);
+        return;
+    }
+
+    struct ws2811_uart_context *ctx = (struct ws2811_uart_context *)arg;
+    WS2811_UART_PROFILE_START(ctx);
+    switch (ctx->state) {
+    case WS2811_UART_STATE_SENDING:
+        ws2811_uart_fill(ctx);
+        break;
+
+    case WS2811_UART_STATE_FINISH:
+        // Let the last byte out, then hold the line low while the UART times the reset.
+        ets_delay_us((WS2811_UART_BYTE_TIME + 999) / 1000);
+        PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO2_U, FUNC_GPIO2);
+        for (int i = 0; i < WS2811_UART_RESET_BYTES; ++i) {
+            WRITE_PERI_REG(UART_FIFO(WS2811_UART_NUM), 0);
+        }
+        ctx->state = WS2811_UART_STATE_RESET;
+        break;
+
+    case WS2811_UART_STATE_RESET:
+        ets_delay_us((WS2811_UART_BYTE_TIME + 999) / 1000);
+        PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO2_U, FUNC_U1TXD_BK);
+        if (ctx->pending) {
+            // The reset time has passed, so we can go straight on to the next frame.
+            ws2811_uart_start(ctx);
+        } else {
+            ctx->state = WS2811_UART_STATE_IDLE;
+            CLEAR_PERI_REG_MASK(UART_INT_ENA(WS2811_UART_NUM), UART_TXFIFO_EMPTY_INT);
+        }
+        if (ctx->frame_done_cb)
+            ctx->frame_done_cb(ctx->frame_done_arg);
+        break;
+
+    default:
+        CLEAR_PERI_REG_MASK(UART_INT_ENA(WS2811_UART_NUM), UART_TXFIFO_EMPTY_INT);
+        break;
+    }
+
+    // Clear last, since the status is set again for as long as the FIFO is below the threshold.
+    WRITE_PERI_REG(UART_INT_CLR(WS2811_UART_NUM), int_st);
+    WS2811_UART_PROFILE_END(ctx, isr);
+}
+
+/**
+ * The handler attached by ws2811_uart_init. Nothing else uses UART0 interrupts then.
+ *
+ * Must be in IRAM.
+ */
+static void ws2811_uart_own_intr(void *arg) {
+    WRITE_PERI_REG(UART_INT_CLR(0), READ_PERI_REG(UART_INT_ST(0)));
+    ws2811_uart_intr(arg);
+}
+
+int ICACHE_FLASH_ATTR ws2811_uart_init(struct ws2811_uart_context *ctx) {
+    os_memset(ctx, 0, sizeof(*ctx));
+
+    ETS_UART_INTR_DISABLE();
+    ETS_UART_INTR_ATTACH(ws2811_uart_own_intr, ctx);
+
+    // The pin is driven low as a GPIO during resets.
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, 1u << WS2811_UART_GPIO);
+    GPIO_REG_WRITE(GPIO_ENABLE_W1TS_ADDRESS, 1u << WS2811_UART_GPIO);
+    PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO2_U, FUNC_U1TXD_BK);
+
+    WRITE_PERI_REG(UART_CLKDIV(WS2811_UART_NUM), (UART_CLK_FREQ / WS2811_UART_BAUD) & UART_CLKDIV_CNT);
+    WRITE_PERI_REG(UART_CONF0(WS2811_UART_NUM),
+                   UART_TXD_INV | (1 << UART_STOP_BIT_NUM_S) | ((6 - 5) << UART_BIT_NUM_S) | UART_TXFIFO_RST);
+    CLEAR_PERI_REG_MASK(UART_CONF0(WS2811_UART_NUM), UART_TXFIFO_RST);
+    ws2811_uart_set_empty_thrhd(WS2811_UART_TXFIFO_THRHD);
+    WRITE_PERI_REG(UART_INT_CLR(WS2811_UART_NUM), 0xFFFF);
+    WRITE_PERI_REG(UART_INT_ENA(WS2811_UART_NUM), 0);
+
+    ETS_UART_INTR_ENABLE();
+
+    return 0;
+}
+
+void ICACHE_FLASH_ATTR ws2811_uart_commit(struct ws2811_uart_context *ctx, size_t len) {
+    if (!len)
+        return;
+
+    if (len > WS2811_UART_MAX_PIXELS)
+        len = WS2811_UART_MAX_PIXELS;
+
+    // Withdraw any pending frame, so the interrupt handler doesn't latch it while we overwrite it.
+    // From here on, every earlier commit has either been latched or superseded.
+    ctx->pending = false;
+    ctx->superseded_frames = ctx->commits - ctx->latches;
+
+    ws2811_uart_encode(ctx, &ctx->frames[!ctx->front], ctx->pixels, len);
+    ++ctx->commits;
+
+    ETS_UART_INTR_DISABLE();
+    ctx->pending = true;
+    if (!ws2811_uart_is_sending(ctx))
+        ws2811_uart_start(ctx);
+    ETS_UART_INTR_ENABLE();
+}
+
+void ICACHE_FLASH_ATTR ws2811_uart_send(struct ws2811_uart_context *ctx, const uint32_t *buf, size_t len) {
+    if (len > WS2811_UART_MAX_PIXELS)
+        len = WS2811_UART_MAX_PIXELS;
+
+    os_memcpy(ctx->pixels, buf, len * sizeof(*buf));
+    ws2811_uart_commit(ctx, len);
+}
@@ -0,0 +1,159 @@
+#ifndef WS2811_ESP8266_UART_H_
+#define WS2811_ESP8266_UART_H_
+
+#include <user_interface.h>
+
+#include "cycle-prof.h"
+
+/* --- Macros --- */
+#ifndef WS2811_UART_BITS_PER_PIXEL
+/**
+ * Number of bits per LED unit. Normally 24 (8-bit RGB).
+ * Must be a multiple of eight. Sent MSB first.
+ */
+#define WS2811_UART_BITS_PER_PIXEL 24
+#endif
+#ifndef WS2811_UART_MAX_PIXELS
+/**
+ * The maximum number of pixels that can be sent in one frame.
+ *
+ * The frame is encoded into context memory before sending. Costs WS2811_UART_BITS_PER_PIXEL bytes per pixel.
+ */
+#define WS2811_UART_MAX_PIXELS 120
+#endif
+#ifndef WS2811_UART_PROFILE
+/**
+ * Whether to measure the interrupt handler and the encoder. See struct ws2811_uart_profile.
+ */
+#define WS2811_UART_PROFILE CYCLE_PROF
+#endif
+/**
+ * The number of UART bytes needed for a full frame. Each byte carries two bits.
+ */
+#define WS2811_UART_MAX_BYTES (WS2811_UART_MAX_PIXELS * WS2811_UART_BITS_PER_PIXEL / 2)
+
+/* --- Types --- */
+typedef enum {
+    WS2811_UART_STATE_IDLE,
+    WS2811_UART_STATE_SENDING,
+    WS2811_UART_STATE_FINISH,
+    WS2811_UART_STATE_RESET,
+} ws2811_uart_state;
+
+/**
+ * Only updated if WS2811_UART_PROFILE is set. The caller may reset them at any time.
+ */
+struct ws2811_uart_profile {
+    struct cycle_prof isr;
+    struct cycle_prof encode;
+};
+
+/**
+ * An encoded frame, ready to be sent.
+ */
+struct ws2811_uart_frame {
+    uint32_t bytes[WS2811_UART_MAX_BYTES / 4]; // Four UART bytes per word, first in the LSB
+    int len;                                   // Number of bytes
+};
+
+struct ws2811_uart_context {
+    volatile ws2811_uart_state state;
+    const uint8_t *txbuf;                    // Next byte to send
+    int txlen;                               // Number of bytes left
+    uint32_t pixels[WS2811_UART_MAX_PIXELS]; // The back buffer
+    struct ws2811_uart_frame frames[2];
+    volatile uint8_t front; // The frame being sent, or last sent
+    volatile bool pending;  // Whether the other frame is waiting to be sent
+    uint32_t commits;
+    volatile uint32_t latches;
+    uint32_t superseded_frames; // Number of committed frames that were replaced before being sent
+    void (*frame_done_cb)(void *arg);
+    void *frame_done_arg;
+#if WS2811_UART_PROFILE
+    struct ws2811_uart_profile prof;
+#endif
+};
+
+/* --- Functions --- */
+/**
+ * Initialize a new WS2811 LED bus context on the UART1 TX pin (GPIO2).
+ *
+ * This sets up UART1 and attaches the UART interrupt handler. The pin mux is handled by the driver.
+ *
+ * UART1 runs inverted 6N1 at 3.2 Mbaud, so each byte is eight 312.5 ns symbols: the start bit (high), six data bits and
+ * the stop bit (low). That makes two WS2811 bits per byte, with 1000 for zero and 1110 for one. The TX FIFO is
+ * refilled from the FIFO-empty interrupt, so a 120 pixel frame needs about 15 interrupts and no timer.
+ *
+ * An inverted UART always sends a high start bit, so the reset can't be sent as data. Instead, the pin is switched to
+ * a low GPIO output while dummy bytes time the reset period.
+ *
+ * UART0 and UART1 share an interrupt. If something else, like a console, attaches its own handler for UART0, it must
+ * call ws2811_uart_intr for UART1.
+ *
+ * @param ctx The context to be initialized.
+ * @return Zero on success.
+ */
+extern int ICACHE_FLASH_ATTR ws2811_uart_init(struct ws2811_uart_context *ctx);
+
+/**
+ * Handle the UART1 interrupt. Only needed if the UART interrupt is owned by someone else. See ws2811_uart_init.
+ *
+ * This is in IRAM.
+ *
+ * @param arg The context.
+ */
+extern void ws2811_uart_intr(void *arg);
+
+/**
+ * Return the back buffer, which holds WS2811_UART_MAX_PIXELS pixels.
+ *
+ * Render into this, and call ws2811_uart_commit. The buffer is never sent directly, so it can be modified at any time.
+ * Only the lower WS2811_UART_BITS_PER_PIXEL bits of each pixel are sent.
+ */
+static inline uint32_t *ws2811_uart_back_buffer(struct ws2811_uart_context *ctx) { return ctx->pixels; }
+
+/**
+ * Encode the back buffer and queue it for sending.
+ *
+ * If the context is idle, sending starts immediately. Otherwise, the frame is sent as soon as the current one is done.
+ * If another frame was already waiting, it is dropped in favour of this one, and counted in superseded_frames.
+ *
+ * @param ctx The context of the bus to send to.
+ * @param len The number of pixels to send. At most WS2811_UART_MAX_PIXELS pixels are sent.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_uart_commit(struct ws2811_uart_context *ctx, size_t len);
+
+/**
+ * Send a buffer of pixel data.
+ *
+ * Copies buf to the back buffer and commits it. See ws2811_uart_commit.
+ *
+ * @param ctx The context of the bus to send to.
+ * @param buf The pixel buffer to send. Only the lower WS2811_UART_BITS_PER_PIXEL bits are sent.
+ * @param len The length of buf, in pixels.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_uart_send(struct ws2811_uart_context *ctx, const uint32_t *buf, size_t len);
+
+/**
+ * Set a function to call every time a frame has been sent, including the reset time.
+ *
+ * The next pending frame, if any, has already started when this is called. Since it is called from the interrupt
+ * handler, the function must be in IRAM and should do little more than system_os_post.
+ *
+ * @param ctx The context of the bus.
+ * @param cb The function to call, or NULL.
+ * @param arg The argument to pass to cb.
+ */
+static inline void ws2811_uart_set_frame_done_cb(struct ws2811_uart_context *ctx, void (*cb)(void *), void *arg) {
+    ctx->frame_done_cb = cb;
+    ctx->frame_done_arg = arg;
+}
+
+/**
+ * Return whether the context is currently sending data.
+ */
+static inline bool ws2811_uart_is_sending(struct ws2811_uart_context *ctx) {
+    return ctx->state != WS2811_UART_STATE_IDLE;
+}
+
+#endif /* WS2811_ESP8266_UART_H_ */
@@ -13,14 +13,25 @@
 #define TIMER1_FLAGS_MASK 0x00CC
 #define TIMER1_COUNT_MASK 0x007FFFFF
 
+#ifndef WS2811_TBIT
 // 2500 ns is too fast even for a simple pulser at 80MHz.
 // https://wp.josh.com/2014/05/13/ws2812-neopixels-are-not-so-finicky-once-you-get-to-know-them/
 // indicates up to 6000 ns is acceptable.
-// 3250 ns causes skipped ticks.
+// 3250 ns caused skipped ticks when the handler decoded pixels itself. Now that it only sends precomputed bit slots,
+// shorter bit times are worth trying, but must be verified against the multivibrator timing of the board.
 // 3500 ns seems stable.
-#define WS2811_TBIT 3500  // ns
+#define WS2811_TBIT 3500 // ns
+#endif
 #define WS2811_TRES 50000 // >=50 us
 
+#if WS2811_PROFILE
+#define WS2811_PROFILE_START(ctx) uint32_t prof_start = cycle_prof_ccount()
+#define WS2811_PROFILE_END(ctx, what) cycle_prof_add(&(ctx)->prof.what, cycle_prof_ccount() - prof_start)
+#else
+#define WS2811_PROFILE_START(ctx)
+#define WS2811_PROFILE_END(ctx, what)
+#endif
+
 /* --- Data --- */
 /**
  * Initialized WS2811 contexts.
@@ -57,6 +68,33 @@ static inline uint32_t ws2811_ns_to_rtc_timer_ticks(uint32_t t, uint32_t div) {
     return t * APB_CLK_FREQ / div / 1000000000;
 }
 
+/**
+ * Latch the pending frame and start sending it.
+ *
+ * Must be called from the interrupt handler, or while the timer is stopped.
+ */
+static inline void ws2811_start(struct ws2811_context *ctx) {
+    uint8_t front = !ctx->front;
+    ctx->front = front;
+    ctx->pending = false;
+    ++ctx->latches;
+
+    ctx->txbits = ctx->frames[front];
+    ctx->txend = ctx->txbits + ctx->frame_lens[front] * WS2811_BITS_PER_PIXEL;
+    ctx->state = WS2811_STATE_BIT;
+
+    RTC_REG_WRITE(FRC1_CTRL_ADDRESS, TIMER1_DIVIDE_BY_1 | TIMER1_ENABLE_TIMER | TIMER1_AUTO_LOAD);
+    ws2811_timer_arm(ws2811_ns_to_rtc_timer_ticks(WS2811_TBIT, 1));
+    TM1_EDGE_INT_ENABLE();
+}
+
+/**
+ * Return how long it takes to send a frame, including the reset time, in ms, rounded up.
+ */
+static inline uint32_t ws2811_frame_ms(size_t len) {
+    return ((uint32_t)len * WS2811_BITS_PER_PIXEL * WS2811_TBIT + WS2811_TRES + 999999) / 1000000;
+}
+
 /**
  * NMI interrupt handler.
  *
@@ -71,41 +109,28 @@ static void ws2811_tx_intr(void) {
 #endif
 #define ctx (*ctxp)
 
+        WS2811_PROFILE_START(ctx);
         switch (ctx->state) {
         case WS2811_STATE_BIT: {
             // Send the next bit.
             // We start by clearing the signal. This negative edge has no impact.
             GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, ctx->gpio_mask_clk);
 
+            // We change the data pin between the clock pin manipulations to widen the pulse slightly.
+#if WS2811_MAX_STRIPS > 1
             {
-                // We change the data pin between the clock pin manipulations to widen the pulse slightly.
-                uint32_t v = *ctx->txbuf & ctx->txmask;
-                GPIO_REG_WRITE((v ? GPIO_OUT_W1TS_ADDRESS : GPIO_OUT_W1TC_ADDRESS), ctx->gpio_mask_data);
+                uint32_t v = ctx->data_masks[*ctx->txbits];
+                GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, v);
+                GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, v ^ ctx->gpio_mask_data);
             }
-            // Now we cause a positive edge.
-            GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, ctx->gpio_mask_clk);
-
-#if WS2811_BIT_ORDER == WS2811_MSBF
-            ctx->txmask >>= 1;
-            if (ctx->txmask)
-                break;
 #else
-            ctx->txmask <<= 1;
-            if (ctx->txmask == 1u << (uint32_t)WS2811_BITS_PER_PIXEL)
-                break;
+            GPIO_REG_WRITE(*ctx->txbits, ctx->gpio_mask_data);
 #endif
+            // Now we cause a positive edge.
+            GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, ctx->gpio_mask_clk);
 
-            // Next pixel.
-            --ctx->txlen;
-            if (ctx->txlen) {
-                ++ctx->txbuf;
-#if WS2811_BIT_ORDER == WS2811_MSBF
-                ctx->txmask = 1u << (uint32_t)(WS2811_BITS_PER_PIXEL - 1);
-#else
-                ctx->txmask = 1;
-#endif
+            if (++ctx->txbits != ctx->txend)
                 break;
-            }
 
             // End of buffer. Wait for final bit to complete.
             ctx->state = WS2811_STATE_FINISH;
@@ -120,18 +145,53 @@ static void ws2811_tx_intr(void) {
             break;
         }
 
-        case WS2811_STATE_IDLE: // Should not happen.
         case WS2811_STATE_RESET:
+            // This is an NMI, so it can't call into the SDK. ws2811_poll passes this on. It must be set before going
+            // idle, since that stops the polling.
+            ctx->frame_done = true;
+            if (ctx->pending) {
+                // The reset time has passed, so we can go straight on to the next frame.
+                ws2811_start(ctx);
+                break;
+            }
+            // Fall through.
+
+        case WS2811_STATE_IDLE: // Should not happen.
             // Ready for new transmission.
             ctx->state = WS2811_STATE_IDLE;
             TM1_EDGE_INT_DISABLE();
             RTC_REG_WRITE(FRC1_CTRL_ADDRESS, 0);
             break;
         }
+        WS2811_PROFILE_END(ctx, isr);
     }
 #undef ctx
 }
 
+/**
+ * Timer callback that calls the frame done callback on behalf of the interrupt handler, in task context.
+ *
+ * Runs while a frame is being sent, first when it should be done, and then every WS2811_POLL_INTERVAL.
+ */
+static void ICACHE_FLASH_ATTR ws2811_poll(void *arg) {
+    struct ws2811_context *ctx = arg;
+
+    // Read the state first. If the handler has gone idle, it has already set frame_done.
+    bool sending = ws2811_is_sending(ctx);
+    uint32_t ms = WS2811_POLL_INTERVAL;
+    if (ctx->frame_done) {
+        ctx->frame_done = false;
+        // The next frame, if any, started when this one was done.
+        ms = ws2811_frame_ms(ctx->frame_lens[ctx->front]);
+        if (ctx->frame_done_cb)
+            ctx->frame_done_cb(ctx->frame_done_arg);
+    }
+
+    ctx->polling = sending;
+    if (sending)
+        os_timer_arm(&ctx->poll_tmr, ms, 0);
+}
+
 /**
  * Add the given context to the interrupt handler contexts.
  * @return Zero on success. Non-zero if there is no space.
@@ -147,6 +207,35 @@ static int ICACHE_FLASH_ATTR ws2811_add_intr_ctx(struct ws2811_context *ctx) {
     return 1;
 }
 
+#if WS2811_MAX_STRIPS > 1
+int ICACHE_FLASH_ATTR ws2811_init(struct ws2811_context *ctx, uint8_t gpio_clk, uint8_t gpio_data) {
+    return ws2811_init_parallel(ctx, gpio_clk, &gpio_data, 1);
+}
+
+int ICACHE_FLASH_ATTR ws2811_init_parallel(struct ws2811_context *ctx, uint8_t gpio_clk, const uint8_t *gpio_data,
+                                           uint8_t num_strips) {
+    if (!num_strips || num_strips > WS2811_MAX_STRIPS)
+        return 1;
+
+    os_memset(ctx, 0, sizeof(*ctx));
+
+    ctx->num_strips = num_strips;
+    ctx->gpio_mask_clk = 1u << gpio_clk;
+    GPIO_OUTPUT_SET(gpio_clk, 0);
+    for (uint8_t i = 0; i < num_strips; ++i) {
+        ctx->gpio_mask_data |= 1u << gpio_data[i];
+        GPIO_OUTPUT_SET(gpio_data[i], 0);
+    }
+    ctx->gpio_mask_all = ctx->gpio_mask_clk | ctx->gpio_mask_data;
+
+    // Bit i of a bit slot is the bit of strip i.
+    for (int v = 0; v < 256; ++v) {
+        for (uint8_t i = 0; i < num_strips; ++i) {
+            if (v & (1 << i))
+                ctx->data_masks[v] |= 1u << gpio_data[i];
+        }
+    }
+#else
 int ICACHE_FLASH_ATTR ws2811_init(struct ws2811_context *ctx, uint8_t gpio_clk, uint8_t gpio_data) {
     os_memset(ctx, 0, sizeof(*ctx));
 
@@ -155,6 +244,7 @@ int ICACHE_FLASH_ATTR ws2811_init(struct ws2811_context *ctx, uint8_t gpio_clk,
     ctx->gpio_mask_all = ctx->gpio_mask_clk | ctx->gpio_mask_data;
     GPIO_OUTPUT_SET(gpio_clk, 0);
     GPIO_OUTPUT_SET(gpio_data, 0);
+#endif
 
     if (!ws2811_intr_ctxs[0]) {
         // First context. Initialize system.
@@ -168,26 +258,87 @@ int ICACHE_FLASH_ATTR ws2811_init(struct ws2811_context *ctx, uint8_t gpio_clk,
     if (ws2811_add_intr_ctx(ctx))
         return 1;
 
+    os_timer_setfn(&ctx->poll_tmr, ws2811_poll, ctx);
+
     return 0;
 }
 
-void ICACHE_FLASH_ATTR ws2811_send(struct ws2811_context *ctx, const uint32_t *buf, size_t len) {
-    if (ws2811_is_sending(ctx))
-        return;
-
-    if (!len)
-        return;
+#if WS2811_MAX_STRIPS > 1
+/**
+ * Transpose the strips' pixels into bit slots, in wire order.
+ */
+static void ICACHE_FLASH_ATTR ws2811_expand(struct ws2811_context *ctx, uint8_t *out, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        uint32_t px[WS2811_MAX_STRIPS];
+        for (uint8_t s = 0; s < ctx->num_strips; ++s) {
+            px[s] = ws2811_strip_buffer(ctx, s)[i];
+        }
 
-    ctx->txbuf = buf;
-    ctx->txlen = len;
 #if WS2811_BIT_ORDER == WS2811_MSBF
-    ctx->txmask = 1u << (uint32_t)(WS2811_BITS_PER_PIXEL - 1);
+        for (int bit = WS2811_BITS_PER_PIXEL - 1; bit >= 0; --bit) {
 #else
-    ctx->txmask = 1;
+        for (int bit = 0; bit < WS2811_BITS_PER_PIXEL; ++bit) {
+#endif
+            uint8_t v = 0;
+            for (uint8_t s = 0; s < ctx->num_strips; ++s) {
+                v |= ((px[s] >> bit) & 1) << s;
+            }
+            *out++ = v;
+        }
+    }
+}
+#else
+/**
+ * Expand the pixels into the GPIO register to write for each bit, in wire order.
+ */
+static void ICACHE_FLASH_ATTR ws2811_expand(struct ws2811_context *ctx, uint8_t *out, size_t len) {
+    for (const uint32_t *p = ctx->pixels, *end = p + len; p != end; ++p) {
+        uint32_t px = *p;
+#if WS2811_BIT_ORDER == WS2811_MSBF
+        for (int bit = WS2811_BITS_PER_PIXEL - 1; bit >= 0; --bit) {
+#else
+        for (int bit = 0; bit < WS2811_BITS_PER_PIXEL; ++bit) {
+#endif
+            *out++ = (px >> bit) & 1 ? GPIO_OUT_W1TS_ADDRESS : GPIO_OUT_W1TC_ADDRESS;
+        }
+    }
+}
 #endif
-    ctx->state = WS2811_STATE_BIT;
 
-    RTC_REG_WRITE(FRC1_CTRL_ADDRESS, TIMER1_DIVIDE_BY_1 | TIMER1_ENABLE_TIMER | TIMER1_AUTO_LOAD);
-    ws2811_timer_arm(ws2811_ns_to_rtc_timer_ticks(WS2811_TBIT, 1));
-    TM1_EDGE_INT_ENABLE();
+void ICACHE_FLASH_ATTR ws2811_commit(struct ws2811_context *ctx, size_t len) {
+    if (!len)
+        return;
+
+    if (len > WS2811_MAX_PIXELS)
+        len = WS2811_MAX_PIXELS;
+
+    // Withdraw any pending frame, so the interrupt handler doesn't latch it while we overwrite it.
+    // From here on, every earlier commit has either been latched or superseded.
+    ctx->pending = false;
+    ctx->superseded_frames = ctx->commits - ctx->latches;
+
+    uint8_t back = !ctx->front;
+    WS2811_PROFILE_START(ctx);
+    ws2811_expand(ctx, ctx->frames[back], len);
+    WS2811_PROFILE_END(ctx, encode);
+    ctx->frame_lens[back] = len;
+    ++ctx->commits;
+
+    // If the interrupt handler goes idle after this, it has seen the flag. If not, we start it.
+    ctx->pending = true;
+    if (!ws2811_is_sending(ctx))
+        ws2811_start(ctx);
+
+    if (!ctx->polling) {
+        ctx->polling = true;
+        os_timer_arm(&ctx->poll_tmr, ws2811_frame_ms(len), 0);
+    }
+}
+
+void ICACHE_FLASH_ATTR ws2811_send(struct ws2811_context *ctx, const uint32_t *buf, size_t len) {
+    if (len > WS2811_MAX_PIXELS)
+        len = WS2811_MAX_PIXELS;
+
+    os_memcpy(ctx->pixels, buf, len * sizeof(*buf));
+    ws2811_commit(ctx, len);
 }
@@ -3,6 +3,8 @@
 
 #include <user_interface.h>
 
+#include "cycle-prof.h"
+
 /* --- Macros --- */
 #ifndef WS2811_MAX_NUM_CONTEXTS
 /**
@@ -24,6 +26,35 @@
  */
 #define WS2811_BIT_ORDER WS2811_MSBF
 #endif
+#ifndef WS2811_MAX_PIXELS
+/**
+ * The maximum number of pixels that can be sent in one frame, per strip. Each pixel costs
+ * 4 * WS2811_MAX_STRIPS + 2 * WS2811_BITS_PER_PIXEL bytes per context.
+ */
+#define WS2811_MAX_PIXELS 120
+#endif
+#ifndef WS2811_MAX_STRIPS
+/**
+ * The maximum number of strips driven in parallel by one context, at most 8. If above one, the context is in parallel
+ * mode, and frames are transposed into one byte per bit slot, with one bit per strip. See ws2811_init_parallel.
+ */
+#define WS2811_MAX_STRIPS 1
+#endif
+#if WS2811_MAX_STRIPS < 1 || WS2811_MAX_STRIPS > 8
+#error "WS2811_MAX_STRIPS must be between 1 and 8"
+#endif
+#ifndef WS2811_POLL_INTERVAL
+/**
+ * How often to check whether the interrupt handler has finished a frame, once it should have, in ms.
+ */
+#define WS2811_POLL_INTERVAL 1
+#endif
+#ifndef WS2811_PROFILE
+/**
+ * Whether to measure the interrupt handler and the frame copy. See struct ws2811_profile.
+ */
+#define WS2811_PROFILE CYCLE_PROF
+#endif
 
 /* --- Types --- */
 typedef enum {
@@ -33,14 +64,43 @@ typedef enum {
     WS2811_STATE_RESET,
 } ws2811_state;
 
+/**
+ * Only updated if WS2811_PROFILE is set. The caller may reset them at any time.
+ */
+struct ws2811_profile {
+    struct cycle_prof isr;
+    struct cycle_prof encode;
+};
+
 struct ws2811_context {
-    ws2811_state state;
+    volatile ws2811_state state;
     uint32_t gpio_mask_clk;
-    uint32_t gpio_mask_data;
+    uint32_t gpio_mask_data; // All data pins
     uint32_t gpio_mask_all;
-    const uint32_t *txbuf;
-    int txlen;
-    uint32_t txmask;
+    const uint8_t *txbits; // Next bit slot to send
+    const uint8_t *txend;
+    uint32_t pixels[WS2811_MAX_STRIPS * WS2811_MAX_PIXELS]; // The back buffer, one strip after another
+    // One byte per bit slot, in wire order. In parallel mode, an index into data_masks. Otherwise, the GPIO register
+    // offset to write the data pin mask to.
+    uint8_t frames[2][WS2811_MAX_PIXELS * WS2811_BITS_PER_PIXEL];
+    size_t frame_lens[2]; // In pixels per strip
+#if WS2811_MAX_STRIPS > 1
+    uint8_t num_strips;
+    uint32_t data_masks[256]; // The data pins to set for each bit slot value
+#endif
+    volatile uint8_t front; // The frame being sent, or last sent
+    volatile bool pending;  // Whether the other frame is waiting to be sent
+    uint32_t commits;
+    volatile uint32_t latches;
+    uint32_t superseded_frames; // Number of committed frames that were replaced before being sent
+    volatile bool frame_done;   // Set by the interrupt handler, cleared by ws2811_poll
+    bool polling;               // Whether poll_tmr is armed
+    os_timer_t poll_tmr;
+    void (*frame_done_cb)(void *arg);
+    void *frame_done_arg;
+#if WS2811_PROFILE
+    struct ws2811_profile prof;
+#endif
 };
 
 /* --- Functions --- */
@@ -78,10 +138,56 @@ struct ws2811_context {
  */
 extern int ICACHE_FLASH_ATTR ws2811_init(struct ws2811_context *ctx, uint8_t gpio_no_clk, uint8_t gpio_no_data);
 
+#if WS2811_MAX_STRIPS > 1
+/**
+ * Initialize a new WS2811 LED bus context that drives several strips in lock-step.
+ *
+ * All strips share the clock pin, which triggers one pair of multivibrators per strip. Each strip has its own data pin.
+ * Every tick sets and clears all data pins with one write each, so the interrupt cost doesn't grow with the number of
+ * strips.
+ *
+ * @param ctx The context to be initialized.
+ * @param gpio_no_clk The pin that will be used to send a high pulse at the start of every cycle.
+ * @param gpio_no_data The data pins, one per strip.
+ * @param num_strips The number of entries in gpio_no_data. At most WS2811_MAX_STRIPS.
+ * @return Zero on success and non-zero on failure.
+ */
+extern int ICACHE_FLASH_ATTR ws2811_init_parallel(struct ws2811_context *ctx, uint8_t gpio_no_clk,
+                                                  const uint8_t *gpio_no_data, uint8_t num_strips);
+#endif
+
+/**
+ * Return the back buffer, which holds WS2811_MAX_PIXELS pixels.
+ *
+ * Render into this, and call ws2811_commit. The buffer is never sent directly, so it can be modified at any time.
+ * Only the lower WS2811_BITS_PER_PIXEL bits of each pixel are sent.
+ */
+static inline uint32_t *ws2811_back_buffer(struct ws2811_context *ctx) { return ctx->pixels; }
+
+/**
+ * Return the back buffer of one strip, which holds WS2811_MAX_PIXELS pixels. Strip zero is ws2811_back_buffer.
+ */
+static inline uint32_t *ws2811_strip_buffer(struct ws2811_context *ctx, uint8_t strip) {
+    return ctx->pixels + strip * WS2811_MAX_PIXELS;
+}
+
+/**
+ * Copy the back buffer and queue it for sending.
+ *
+ * If the context is idle, sending starts immediately. Otherwise, the frame is sent as soon as the current one is done.
+ * If another frame was already waiting, it is dropped in favour of this one, and counted in superseded_frames.
+ *
+ * In parallel mode, the first len pixels of every strip's buffer are sent.
+ *
+ * @param ctx The context of the bus to send to.
+ * @param len The number of pixels to send. At most WS2811_MAX_PIXELS pixels are sent.
+ */
+extern void ICACHE_FLASH_ATTR ws2811_commit(struct ws2811_context *ctx, size_t len);
+
 /**
  * Send a buffer of pixel data.
  *
- * If the context is already sending data, this function does nothing.
+ * Copies buf to the back buffer and commits it. See ws2811_commit. In parallel mode, buf is sent on the first strip.
  *
  * @param ctx The context of the bus to send to.
  * @param buf The pixel buffer to send. Only the lower WS2811_BITS_PER_PIXEL bits are sent.
@@ -89,6 +195,22 @@ extern int ICACHE_FLASH_ATTR ws2811_init(struct ws2811_context *ctx, uint8_t gpi
  */
 extern void ICACHE_FLASH_ATTR ws2811_send(struct ws2811_context *ctx, const uint32_t *buf, size_t len);
 
+/**
+ * Set a function to call every time a frame has been sent, including the reset time.
+ *
+ * The next pending frame, if any, has already started when this is called. The interrupt handler is an NMI, which must
+ * not call into the SDK, so it only sets a flag, and a timer calls the function in task context, within
+ * WS2811_POLL_INTERVAL. If several frames were sent in the meantime, it is called once.
+ *
+ * @param ctx The context of the bus.
+ * @param cb The function to call, or NULL.
+ * @param arg The argument to pass to cb.
+ */
+static inline void ws2811_set_frame_done_cb(struct ws2811_context *ctx, void (*cb)(void *), void *arg) {
+    ctx->frame_done_cb = cb;
+    ctx->frame_done_arg = arg;
+}
+
 /**
  * Return whether the context is currently sending data.
  */
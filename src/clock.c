@@ -1,5 +1,14 @@
 /**
  * A simple LED clock module using SNTP for time.
+ *
+ * Converting to local time takes gmtime_r and the time zone rules, but the result only changes once per second. So the
+ * local time is kept broken down, and advanced a second at a time from system_get_time. It is only converted in full at
+ * the top of every hour, which is when DST may change, and when SNTP disagrees.
+ *
+ * SNTP only counts whole seconds, so the system time at which its second changes is latched, and the fraction of the
+ * second is interpolated from there. The length of an SNTP second is measured between latches, so the clock keeps
+ * running at the right rate if SNTP stops ticking for a while. The latch is only as good as the frame rate, but the
+ * averaging evens that out.
  */
 #include <osapi.h>
 #include <sntp.h>
@@ -7,106 +16,245 @@
 
 #include "clock.h"
 
-/* --- Types --- */
-struct sparkle_sprite {
-    uint32_t *led_buf;
-    uint8_t led_buf_size;
-
-    uint32_t color;
-    uint8_t index;
-    uint8_t att;
-    int32_t delay; // µs per pixel
-};
+/* --- Macros --- */
+#define CLOCK_SECOND 1000000 // µs
+// Measured seconds further off than this are assumed to be missed latches, and ignored.
+#define CLOCK_MAX_LATCH_ERROR 50000 // µs
+// The measured second length is limited to this much drift.
+#define CLOCK_MAX_DRIFT (CLOCK_SECOND / 100) // µs
+// Each measurement moves the second length by 1/CLOCK_DISCIPLINE_GAIN of its error.
+#define CLOCK_DISCIPLINE_GAIN 16
+// The ring size the hand profiles are designed for.
+#define CLOCK_BASE_SIZE 120
+// The sparks sent off both ways when the minute changes.
+#define CLOCK_SPARKLE_COLOR 0x7F7F00
+#define CLOCK_SPARKLE_SPEED 10       // LEDs per second, on a CLOCK_BASE_SIZE ring
+#define CLOCK_SPARKLE_FADE (10 << 8) // 8.8 halvings per second
 
 /* --- Functions --- */
 extern void ets_memset(void *, uint8_t, int);
 extern void ets_printf(const char *, ...);
 
 /* --- Data --- */
-static const int MDAYS[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
-static void ICACHE_FLASH_ATTR sparkle_sprite_init(struct sparkle_sprite *sp, uint32_t *buf, uint8_t size,
-                                                  uint32_t color, int8_t index) {
-    sp->led_buf = buf;
-    sp->led_buf_size = size;
-
-    sp->color = color;
-    sp->att = 1;
-    if (index < 0) {
-        sp->index = -index;
-        sp->delay = -100000;
-    } else {
-        sp->index = index;
-        sp->delay = 100000;
+// Hand profiles on a CLOCK_BASE_SIZE ring, from the centre outwards.
+static const uint8_t HOUR_HAND[] = {0x3F, 0x1F, 0x07};
+static const uint8_t MINUTE_HAND[] = {0x7F, 0x1F};
+static const uint8_t SECOND_HAND[] = {0x3F, 0x0F};
+
+/**
+ * Convert ctx->t to local time from scratch.
+ */
+static void ICACHE_FLASH_ATTR clock_resync(struct clock_context *ctx) { tz_localtime_r(&ctx->tz, &ctx->t, &ctx->tm); }
+
+/**
+ * Move the clock one second forward.
+ */
+static void ICACHE_FLASH_ATTR clock_tick(struct clock_context *ctx) {
+    ++ctx->t;
+    if (++ctx->tm.tm_sec < 60) {
+        return;
+    }
+    ctx->tm.tm_sec = 0;
+    if (++ctx->tm.tm_min < 60) {
+        return;
+    }
+    // A new hour may bring a new day, month or DST change.
+    clock_resync(ctx);
+}
+
+/**
+ * Account for an SNTP second that started at now.
+ */
+static void ICACHE_FLASH_ATTR clock_discipline(struct clock_context *ctx, uint32_t now) {
+    if (ctx->latched) {
+        int32_t err = (int32_t)(now - ctx->latch_time - ctx->second_len);
+        if (err > -CLOCK_MAX_LATCH_ERROR && err < CLOCK_MAX_LATCH_ERROR) {
+            ctx->second_len += err / CLOCK_DISCIPLINE_GAIN;
+            if (ctx->second_len < CLOCK_SECOND - CLOCK_MAX_DRIFT) {
+                ctx->second_len = CLOCK_SECOND - CLOCK_MAX_DRIFT;
+            } else if (ctx->second_len > CLOCK_SECOND + CLOCK_MAX_DRIFT) {
+                ctx->second_len = CLOCK_SECOND + CLOCK_MAX_DRIFT;
+            }
+            ctx->second_recip = ((uint64_t)1 << 40) / ctx->second_len;
+        }
     }
+    ctx->latch_time = now;
+    ctx->latched = true;
 }
 
-static void ICACHE_FLASH_ATTR sparkle_sprite_draw(struct sparkle_sprite *sp) { sp->led_buf[sp->index] = sp->color; }
+/**
+ * Bring the clock up to date.
+ *
+ * A new SNTP second starts a new second here too, and is latched. Between them, the clock runs on its own from
+ * system_get_time, in case SNTP misses a tick. An SNTP second that is neither the current nor the next one is an SNTP
+ * update, and causes a full resync.
+ */
+static void ICACHE_FLASH_ATTR clock_advance(struct clock_context *ctx, time_t sntp_t) {
+    uint32_t now = system_get_time();
+
+    if (!ctx->synced) {
+        ctx->t = sntp_t;
+        ctx->tick_time = now;
+        ctx->sntp_t = sntp_t;
+        ctx->latched = false;
+        if (!ctx->second_len) {
+            ctx->second_len = CLOCK_SECOND;
+            ctx->second_recip = ((uint64_t)1 << 40) / CLOCK_SECOND;
+        }
+        ctx->synced = true;
+        clock_resync(ctx);
+        return;
+    }
 
-static bool ICACHE_FLASH_ATTR sparkle_sprite_update(struct sparkle_sprite *sp, int32_t dt_us) {
-    static const uint32_t ATT_MASKS[] = {
-        0xFFFFFFFF, 0x7F7F7F7F, 0x3F3F3F3F, 0x1F1F1F1F, 0x0F0F0F0F, 0x07070707, 0x03030303, 0x01010101,
-    };
+    if (sntp_t != ctx->sntp_t) {
+        if (sntp_t == ctx->sntp_t + 1) {
+            clock_discipline(ctx, now);
+        } else {
+            ctx->latched = false;
+        }
+        ctx->sntp_t = sntp_t;
 
-    int32_t abs_delay = (sp->delay < 0 ? -sp->delay : sp->delay);
-    // TODO(tommie): Make this work with unaligned delays.
-    int32_t nt = (dt_us + abs_delay / 2) / sp->delay;
-    sp->index = (sp->index + nt + sp->led_buf_size) % sp->led_buf_size;
+        if (sntp_t == ctx->t + 1) {
+            clock_tick(ctx);
+        } else if (sntp_t != ctx->t) {
+            ctx->synced = false;
+            clock_advance(ctx, sntp_t);
+            return;
+        }
+        ctx->tick_time = now;
+        return;
+    }
 
-    uint8_t n = (nt < 0 ? -nt : nt);
-    if (n * sp->att >= 8) {
-        sp->color = 0;
-    } else {
-        sp->color >>= n * sp->att;
-        sp->color &= ATT_MASKS[n * sp->att];
+    while (now - ctx->tick_time >= ctx->second_len) {
+        ctx->tick_time += ctx->second_len;
+        clock_tick(ctx);
     }
-    return sp->color != 0;
 }
 
-static int ICACHE_FLASH_ATTR cmp_last_wday_of_month(const struct tm *tm, int wday) {
-    int mdays = MDAYS[tm->tm_mon];
-    if (tm->tm_mon == 1) {
-        // Leap year for February.
-        int y = 1900 + tm->tm_year;
-        mdays += ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0 ? 1 : 0);
+#if CLOCK_SMOOTH_SECONDS
+/**
+ * Return how much of the current second has passed, in 1/256.
+ */
+static uint8_t ICACHE_FLASH_ATTR clock_fraction(struct clock_context *ctx) {
+    uint32_t dt = system_get_time() - ctx->tick_time;
+    if (dt >= ctx->second_len) {
+        return 255;
     }
-    // TODO(tommie): Test this.
-    int prev_day = tm->tm_mday - (tm->tm_wday + 7 - wday) % 7;
-    return prev_day + 7 - mdays;
+    return (uint64_t)dt * ctx->second_recip >> 32;
 }
+#endif
 
-static bool ICACHE_FLASH_ATTR is_after_last_wday_hour_of_month(const struct tm *tm, int mon, int wday, int hour) {
-    if (tm->tm_mon != mon) {
-        return tm->tm_mon > mon;
+/**
+ * Add a hand to the hands layer, centred on pos, in 1/256 LEDs.
+ *
+ * Each weight is split between neighbouring LEDs by the fractional part of pos, so the hand moves smoothly.
+ */
+static void ICACHE_FLASH_ATTR clock_draw_hand(struct clock_context *ctx, uint32_t pos, const struct clock_hand *hand,
+                                              uint8_t shift) {
+    uint32_t frac = pos & 0xFF;
+    uint16_t i = (pos >> 8) + ctx->led_buf_size - (hand->len >> 1);
+    if (i >= ctx->led_buf_size) {
+        i -= ctx->led_buf_size;
     }
-    int cmpmday = cmp_last_wday_of_month(tm, wday);
-    if (cmpmday) {
-        return cmpmday > 0;
+    for (uint8_t k = 0; k <= hand->len; ++k) {
+        uint32_t v =
+            ((k < hand->len ? hand->weights[k] * (256 - frac) : 0) + (k ? hand->weights[k - 1] * frac : 0)) >> 8;
+        if (v) {
+            ctx->hands[i] = compose_add(ctx->hands[i], v << shift);
+        }
+        if (++i == ctx->led_buf_size) {
+            i = 0;
+        }
+    }
+}
+
+/**
+ * Resample a hand profile designed for CLOCK_BASE_SIZE LEDs to the ring size, and mirror it.
+ */
+static void ICACHE_FLASH_ATTR clock_init_hand(struct clock_hand *hand, const uint8_t *profile, uint8_t n,
+                                              uint16_t size) {
+    uint8_t half = 0;
+    uint8_t w[CLOCK_MAX_HAND_LEN / 2 + 1];
+    for (; half < sizeof(w); ++half) {
+        uint32_t x = (uint32_t)half * CLOCK_BASE_SIZE * 256 / size;
+        uint32_t j = x >> 8;
+        if (j >= n) {
+            break;
+        }
+        uint32_t f = x & 0xFF;
+        w[half] = (profile[j] * (256 - f) + (j + 1 < n ? profile[j + 1] : 0) * f) >> 8;
+    }
+
+    hand->len = 2 * half - 1;
+    for (uint8_t k = 0; k < half; ++k) {
+        hand->weights[half - 1 - k] = w[k];
+        hand->weights[half - 1 + k] = w[k];
     }
-    return tm->tm_hour >= hour;
 }
 
-static void ICACHE_FLASH_ATTR mylocaltime_r(const time_t *t, struct tm *tm) {
-    gmtime_r(t, tm);
-    // Ireland DST/TZ rules.
-    tm->tm_isdst = is_after_last_wday_hour_of_month(tm, 2, 0, 1) && !is_after_last_wday_hour_of_month(tm, 9, 0, 0);
-    tm->tm_hour += 0 + (tm->tm_isdst ? 1 : 0);
-    mktime(tm);
+/**
+ * Draw the background, and set up the layers.
+ */
+static void ICACHE_FLASH_ATTR clock_init_layers(struct clock_context *ctx) {
+    ctx->num_layers = 0;
+    if (CLOCK_MARKER_COLOR) {
+        for (uint8_t h = 0; h < 12; ++h) {
+            uint16_t i = (ctx->hour_pos[h] + 128) >> 8;
+            ctx->background[i < ctx->led_buf_size ? i : 0] = CLOCK_MARKER_COLOR;
+        }
+        ctx->layers[ctx->num_layers++] = (struct compose_layer){ctx->background, COMPOSE_COPY};
+    }
+    ctx->layers[ctx->num_layers++] = (struct compose_layer){ctx->hands, COMPOSE_ADD};
+    ctx->layers[ctx->num_layers++] = (struct compose_layer){ctx->sprites, COMPOSE_ADD};
 }
 
-bool ICACHE_FLASH_ATTR clock_init(struct clock_context *ctx, uint32_t *led_buf, uint8_t led_buf_size) {
-    if (led_buf_size != 120) {
+bool ICACHE_FLASH_ATTR clock_init(struct clock_context *ctx, uint32_t *led_buf, uint16_t led_buf_size) {
+    if (!led_buf_size || led_buf_size > CLOCK_MAX_LEDS) {
         return false;
     }
 
     os_memset(ctx, 0, sizeof(*ctx));
     ctx->led_buf = led_buf;
+    ctx->led_buf_size = led_buf_size;
+    if (!tz_parse(&ctx->tz, CLOCK_TZ)) {
+        return false;
+    }
+
+    for (uint8_t h = 0; h < 12; ++h) {
+        ctx->hour_pos[h] = ((uint32_t)h * led_buf_size * 256 + 6) / 12;
+    }
+    for (uint8_t m = 0; m < 60; ++m) {
+        ctx->minute_pos[m] = ((uint32_t)m * led_buf_size * 256 + 30) / 60;
+    }
+    ctx->second_step = ((uint32_t)led_buf_size * 256 + 30) / 60;
+    clock_init_hand(&ctx->hour_hand, HOUR_HAND, sizeof(HOUR_HAND), led_buf_size);
+    clock_init_hand(&ctx->minute_hand, MINUTE_HAND, sizeof(MINUTE_HAND), led_buf_size);
+    clock_init_hand(&ctx->second_hand, SECOND_HAND, sizeof(SECOND_HAND), led_buf_size);
+    clock_init_layers(ctx);
+    sprite_pool_init(&ctx->sparkles, ctx->sprites, led_buf_size);
+    ctx->sparkle_vel = SPRITE_LEDS(CLOCK_SPARKLE_SPEED) / CLOCK_BASE_SIZE * led_buf_size;
+    ctx->update_time = system_get_time();
 
     sntp_setservername(0, (char *)"2.pool.ntp.org");
     sntp_setservername(1, (char *)"3.pool.ntp.org");
     sntp_setservername(2, (char *)"0.pool.ntp.org");
     sntp_set_timezone(0);
     sntp_init();
+
+    return true;
+}
+
+bool ICACHE_FLASH_ATTR clock_set_tz(struct clock_context *ctx, const char *tz) {
+    if (!tz_parse(&ctx->tz, tz)) {
+        return false;
+    }
+    ctx->synced = false;
+    return true;
+}
+
+const char *ICACHE_FLASH_ATTR clock_tz_name(struct clock_context *ctx) {
+    time_t t = sntp_get_current_timestamp();
+    return t ? tz_name(&ctx->tz, t) : NULL;
 }
 
 bool ICACHE_FLASH_ATTR clock_is_valid(struct clock_context *ctx) { return sntp_get_current_timestamp() > 0; }
@@ -117,47 +265,33 @@ void ICACHE_FLASH_ATTR clock_update(struct clock_context *ctx) {
         return;
     }
 
-    struct tm tm;
-    mylocaltime_r(&t, &tm);
+    uint32_t now = system_get_time();
+    clock_advance(ctx, t);
+    struct tm tm = ctx->tm;
 #if 0
     ets_printf("T %02d:%02d:%02d\n", tm.tm_hour, tm.tm_min, tm.tm_sec);
 #endif
 
-    os_memset(ctx->led_buf, 0, 120 * sizeof(*ctx->led_buf));
-    uint8_t ih = (tm.tm_hour % 12) * 120 / 12;
-    uint8_t im = tm.tm_min * 120 / 60;
-    uint8_t is = tm.tm_sec * 120 / 60;
-
-    ctx->led_buf[(ih - 2 + 120) % 120] |= 0x070000;
-    ctx->led_buf[(ih - 1 + 120) % 120] |= 0x1F0000;
-    ctx->led_buf[ih] |= 0x3F0000;
-    ctx->led_buf[(ih + 1) % 120] |= 0x1F0000;
-    ctx->led_buf[(ih + 2) % 120] |= 0x070000;
-
-    ctx->led_buf[(im - 1 + 120) % 120] |= 0x001F00;
-    ctx->led_buf[im] |= 0x007F00;
-    ctx->led_buf[(im + 1) % 120] |= 0x001F00;
+    os_memset(ctx->hands, 0, ctx->led_buf_size * sizeof(*ctx->hands));
+    os_memset(ctx->sprites, 0, ctx->led_buf_size * sizeof(*ctx->sprites));
+    uint32_t ih = ctx->hour_pos[tm.tm_hour >= 12 ? tm.tm_hour - 12 : tm.tm_hour];
+    uint32_t im = ctx->minute_pos[tm.tm_min];
+    uint32_t is = ctx->minute_pos[tm.tm_sec];
+#if CLOCK_SMOOTH_SECONDS
+    is += clock_fraction(ctx) * ctx->second_step >> 8;
+#endif
 
-    ctx->led_buf[(is - 1 + 120) % 120] |= 0x00000F;
-    ctx->led_buf[is] |= 0x00003F;
-    ctx->led_buf[(is + 1) % 120] |= 0x00000F;
+    clock_draw_hand(ctx, ih, &ctx->hour_hand, 16);
+    clock_draw_hand(ctx, im, &ctx->minute_hand, 8);
+    clock_draw_hand(ctx, is, &ctx->second_hand, 0);
 
-    static struct sparkle_sprite minute_sparkle[2];
-    static bool minute_sparkle_alive[2];
     if (tm.tm_min != ctx->prev_tm.tm_min) {
-        sparkle_sprite_init(&minute_sparkle[0], ctx->led_buf, 120, 0x7F7F00, im);
-        sparkle_sprite_init(&minute_sparkle[1], ctx->led_buf, 120, 0x7F7F00, -im);
-        minute_sparkle_alive[0] = true;
-        minute_sparkle_alive[1] = true;
-    }
-    for (uint8_t i = 0; i < 2; ++i) {
-        if (minute_sparkle_alive[i]) {
-            minute_sparkle_alive[i] = sparkle_sprite_update(&minute_sparkle[i], 50000);
-        }
-        if (minute_sparkle_alive[i]) {
-            sparkle_sprite_draw(&minute_sparkle[i]);
-        }
+        sprite_add(&ctx->sparkles, im << 8, ctx->sparkle_vel, CLOCK_SPARKLE_COLOR, CLOCK_SPARKLE_FADE);
+        sprite_add(&ctx->sparkles, im << 8, -ctx->sparkle_vel, CLOCK_SPARKLE_COLOR, CLOCK_SPARKLE_FADE);
     }
+    sprite_update(&ctx->sparkles, now - ctx->update_time);
+    ctx->update_time = now;
 
+    compose_layers(ctx->led_buf, ctx->layers, ctx->num_layers, ctx->led_buf_size);
     ctx->prev_tm = tm;
 }
@@ -4,10 +4,95 @@
 #include <time.h>
 #include <user_interface.h>
 
+#include "compose.h"
+#include "sprite.h"
+#include "tz.h"
+
+/* --- Macros --- */
+#ifndef CLOCK_SMOOTH_SECONDS
+/**
+ * Whether the second hand sweeps smoothly, instead of stepping once a second.
+ *
+ * Off by default, since a sweeping hand changes every frame. The display is then never static, so unchanged frames are
+ * never skipped, and the power manager never dozes.
+ */
+#define CLOCK_SMOOTH_SECONDS 0
+#endif
+
+#ifndef CLOCK_MAX_LEDS
+/**
+ * The largest ring size. Each LED costs 12 bytes of layer buffers in the context.
+ */
+#define CLOCK_MAX_LEDS 120
+#endif
+
+#ifndef CLOCK_MARKER_COLOR
+/**
+ * Colour of the hour markers in the background layer, as 0x00GGRRBB. Zero disables the background layer.
+ */
+#define CLOCK_MARKER_COLOR 0
+#endif
+
+#ifndef CLOCK_MAX_HAND_LEN
+/**
+ * Maximum number of LEDs in a hand. Hands are scaled with the ring size, and cut off at this length on large rings.
+ */
+#define CLOCK_MAX_HAND_LEN 17
+#endif
+
+#ifndef CLOCK_TZ
+/**
+ * The default time zone, as a POSIX TZ string. Ireland.
+ */
+#define CLOCK_TZ "GMT0IST,M3.5.0/1,M10.5.0"
+#endif
+
 /* --- Types --- */
+/**
+ * A hand's brightness profile, scaled to the ring size.
+ */
+struct clock_hand {
+    uint8_t len; // Number of LEDs
+    uint8_t weights[CLOCK_MAX_HAND_LEN];
+};
+
 struct clock_context {
     uint32_t *led_buf;
+    uint16_t led_buf_size;
     struct tm prev_tm;
+    struct tz tz;
+
+    // The wall clock, advanced incrementally. See clock_advance.
+    bool synced;        // Whether t and tm are set
+    time_t t;           // UTC
+    struct tm tm;       // Local time of t
+    uint32_t tick_time; // system_get_time at which t started
+
+    // Disciplining against SNTP. See clock_discipline.
+    time_t sntp_t;         // The last SNTP second seen
+    uint32_t latch_time;   // system_get_time at which sntp_t was first seen
+    bool latched;          // Whether latch_time is the start of an SNTP second
+    uint32_t second_len;   // Length of an SNTP second, in system_get_time µs
+    uint32_t second_recip; // 2^40 / second_len
+
+    // Computed by clock_init, so drawing needs no divisions. Positions are in 1/256 LEDs.
+    uint32_t hour_pos[12];
+    uint32_t minute_pos[60]; // Also used for seconds
+    uint32_t second_step;    // How far the second hand moves in a second
+    struct clock_hand hour_hand;
+    struct clock_hand minute_hand;
+    struct clock_hand second_hand;
+
+    // Composed into led_buf, bottom first.
+    uint32_t background[CLOCK_MAX_LEDS]; // Drawn once by clock_init
+    uint32_t hands[CLOCK_MAX_LEDS];
+    uint32_t sprites[CLOCK_MAX_LEDS];
+    struct compose_layer layers[3];
+    uint8_t num_layers;
+
+    struct sprite_pool sparkles; // Drawn into sprites
+    int32_t sparkle_vel;         // 16.16 LEDs per second
+    uint32_t update_time;        // system_get_time of the last clock_update
 };
 
 /* --- Functions --- */
@@ -16,10 +101,26 @@ struct clock_context {
  *
  * @param ctx the clock context.
  * @param led_buf the buffer to write to on updates.
- * @param led_buf_size the number of LEDs. Must be 120.
+ * @param led_buf_size the number of LEDs in the ring. At most CLOCK_MAX_LEDS.
  * @return true on success.
  */
-extern bool ICACHE_FLASH_ATTR clock_init(struct clock_context *ctx, uint32_t *led_buf, uint8_t led_buf_size);
+extern bool ICACHE_FLASH_ATTR clock_init(struct clock_context *ctx, uint32_t *led_buf, uint16_t led_buf_size);
+
+/**
+ * Set the time zone.
+ *
+ * @param ctx the clock context.
+ * @param tz a POSIX TZ string, e.g. "CET-1CEST,M3.5.0,M10.5.0/3".
+ * @return true on success. On failure, the zone is unchanged.
+ */
+extern bool ICACHE_FLASH_ATTR clock_set_tz(struct clock_context *ctx, const char *tz);
+
+/**
+ * Return the abbreviation of the zone currently in effect, or NULL if the clock isn't valid.
+ *
+ * @param ctx the clock context.
+ */
+extern const char *ICACHE_FLASH_ATTR clock_tz_name(struct clock_context *ctx);
 
 /**
  * Check whether the realtime clock is valid.
@@ -0,0 +1,52 @@
+/**
+ * Layer composition on packed 0x00GGRRBB pixels.
+ *
+ * The blend functions in compose.h work on a whole pixel at a time: red and blue share one word, with a spare bit
+ * above each for carries and borrows, and green is handled in another. That keeps every blend mode free of branches
+ * and per-channel unpacking.
+ */
+#include <osapi.h>
+
+#include "compose.h"
+
+/* --- Functions --- */
+extern void ets_memcpy(void *, const void *, int);
+
+void ICACHE_FLASH_ATTR compose_layers(uint32_t *out, const struct compose_layer *layers, uint8_t n, uint16_t len) {
+    if (out != layers[0].buf) {
+        os_memcpy(out, layers[0].buf, len * sizeof(*out));
+    }
+
+    for (const struct compose_layer *layer = layers + 1; layer != layers + n; ++layer) {
+        const uint32_t *in = layer->buf;
+        uint32_t *p = out;
+        uint32_t *end = out + len;
+
+        // One loop per mode, so the mode isn't tested per pixel.
+        switch (layer->mode) {
+        case COMPOSE_COPY:
+            os_memcpy(out, in, len * sizeof(*out));
+            break;
+
+        case COMPOSE_ADD:
+            for (; p != end; ++p, ++in) {
+                if (*in) {
+                    *p = compose_add(*p, *in);
+                }
+            }
+            break;
+
+        case COMPOSE_MAX:
+            for (; p != end; ++p, ++in) {
+                *p = compose_max(*p, *in);
+            }
+            break;
+
+        case COMPOSE_ALPHA:
+            for (; p != end; ++p, ++in) {
+                *p = compose_alpha(*in, *p, layer->alpha);
+            }
+            break;
+        }
+    }
+}
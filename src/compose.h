@@ -0,0 +1,80 @@
+#ifndef SUBSPACE_SIGN_COMPOSE_H
+#define SUBSPACE_SIGN_COMPOSE_H
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+// The channels of a 0x00GGRRBB pixel, in two words with a guard bit above each channel.
+#define COMPOSE_RB 0x00FF00FF
+#define COMPOSE_RB_GUARD 0x01000100
+#define COMPOSE_G 0x0000FF00
+#define COMPOSE_G_GUARD 0x00010000
+
+/* --- Types --- */
+enum compose_mode {
+    COMPOSE_COPY,  // Replace
+    COMPOSE_ADD,   // Add, saturating each channel
+    COMPOSE_MAX,   // The larger of each channel
+    COMPOSE_ALPHA, // Mix by alpha
+};
+
+struct compose_layer {
+    const uint32_t *buf; // 0x00GGRRBB
+    enum compose_mode mode;
+    uint16_t alpha; // For COMPOSE_ALPHA: 0 (transparent) to 256 (opaque)
+};
+
+/* --- Functions --- */
+/**
+ * Add two pixels, saturating each channel at 0xFF.
+ *
+ * The guard bits catch the carries, which are then spread into masks of the overflowed channels.
+ */
+static inline uint32_t compose_add(uint32_t a, uint32_t b) {
+    uint32_t rb = (a & COMPOSE_RB) + (b & COMPOSE_RB);
+    uint32_t rb_carry = rb & COMPOSE_RB_GUARD;
+    uint32_t g = (a & COMPOSE_G) + (b & COMPOSE_G);
+    uint32_t g_carry = g & COMPOSE_G_GUARD;
+
+    return ((rb | (rb_carry - (rb_carry >> 8))) & COMPOSE_RB) | ((g | (g_carry - (g_carry >> 8))) & COMPOSE_G);
+}
+
+/**
+ * Return the larger of each channel of two pixels.
+ *
+ * a - b is computed with the guard bits set, so each one survives the borrow only where a >= b.
+ */
+static inline uint32_t compose_max(uint32_t a, uint32_t b) {
+    uint32_t rb_ge = (((a & COMPOSE_RB) | COMPOSE_RB_GUARD) - (b & COMPOSE_RB)) & COMPOSE_RB_GUARD;
+    uint32_t g_ge = (((a & COMPOSE_G) | COMPOSE_G_GUARD) - (b & COMPOSE_G)) & COMPOSE_G_GUARD;
+    uint32_t mask = (rb_ge - (rb_ge >> 8)) | (g_ge - (g_ge >> 8));
+
+    return (a & mask) | (b & ~mask & (COMPOSE_RB | COMPOSE_G));
+}
+
+/**
+ * Mix two pixels, (a * alpha + b * (256 - alpha)) / 256 for each channel.
+ *
+ * @param alpha 0 gives b, 256 gives a.
+ */
+static inline uint32_t compose_alpha(uint32_t a, uint32_t b, uint16_t alpha) {
+    uint32_t beta = 256 - alpha;
+    uint32_t rb = (((a & COMPOSE_RB) * alpha + (b & COMPOSE_RB) * beta) >> 8) & COMPOSE_RB;
+    uint32_t g = (((a & COMPOSE_G) * alpha + (b & COMPOSE_G) * beta) >> 8) & COMPOSE_G;
+    return rb | g;
+}
+
+/**
+ * Compose layers into out, bottom first.
+ *
+ * The first layer is always copied, whatever its mode.
+ *
+ * @param out the result. May be the buffer of the first layer, but no other.
+ * @param layers the layers.
+ * @param n the number of layers. At least one.
+ * @param len the number of pixels in each buffer.
+ */
+extern void ICACHE_FLASH_ATTR compose_layers(uint32_t *out, const struct compose_layer *layers, uint8_t n,
+                                             uint16_t len);
+
+#endif /* SUBSPACE_SIGN_COMPOSE_H */
@@ -0,0 +1,239 @@
+/**
+ * A line-oriented command console on UART0.
+ *
+ * The interrupt handler only moves bytes from the UART FIFO into a single-producer/single-consumer ring buffer. Only
+ * the handler writes the head, and only console_process writes the tail, so no locking is needed.
+ *
+ * The I2S LED driver muxes U0RXD to I2SO_DATA, so in that configuration nothing will be received. Commands can then
+ * be sent over UDP instead. They are run from the espconn callback, which is already in task context.
+ */
+#include <eagle_soc.h>
+#include <espconn.h>
+#include <ets_sys.h>
+#include <osapi.h>
+
+#include "console.h"
+#include "uart_register.h"
+
+/* --- Macros --- */
+// The indices are 8 bits, and a full buffer must not look empty.
+#if CONSOLE_RX_BUF_SIZE & (CONSOLE_RX_BUF_SIZE - 1) || CONSOLE_RX_BUF_SIZE >= 256
+#error "CONSOLE_RX_BUF_SIZE must be a power of two, at most 128"
+#endif
+#define CONSOLE_RX_BUF_MASK (CONSOLE_RX_BUF_SIZE - 1)
+
+#define CONSOLE_UART 0
+#define CONSOLE_RXFIFO_FULL_THRHD 32 // bytes
+#define CONSOLE_RX_TOUT_THRHD 2      // byte times
+
+/* --- Functions --- */
+extern void ets_printf(const char *, ...);
+
+/* --- Data --- */
+static volatile uint8_t console_rx_buf[CONSOLE_RX_BUF_SIZE];
+static volatile uint8_t console_rx_head; // Written by console_intr
+static volatile uint8_t console_rx_tail; // Written by console_process
+static volatile uint32_t console_rx_dropped;
+static void (*console_rx_cb)(void *arg);
+static void *console_rx_arg;
+static void (*console_uart1_intr)(void *arg);
+static void *console_uart1_arg;
+
+static const struct console_command *console_commands;
+static char console_line[CONSOLE_LINE_LEN];
+static uint8_t console_line_len;
+static bool console_line_overflow;
+#if CONSOLE_UDP_PORT
+static struct espconn console_conn;
+static esp_udp console_udp;
+#endif
+
+// Must be in IRAM.
+static void console_intr(void *arg) {
+    uint32_t st = READ_PERI_REG(UART_INT_ST(CONSOLE_UART));
+
+    if (st & (UART_RXFIFO_FULL_INT | UART_RXFIFO_TOUT_INT)) {
+        uint8_t head = console_rx_head;
+        for (uint32_t n = (READ_PERI_REG(UART_STATUS(CONSOLE_UART)) >> UART_RXFIFO_CNT_S) & UART_RXFIFO_CNT; n; --n) {
+            uint8_t c = READ_PERI_REG(UART_FIFO(CONSOLE_UART)) & UART_RXFIFO_RD_BYTE;
+            if ((uint8_t)(head - console_rx_tail) == CONSOLE_RX_BUF_SIZE) {
+                ++console_rx_dropped;
+                continue;
+            }
+            console_rx_buf[head & CONSOLE_RX_BUF_MASK] = c;
+            ++head;
+        }
+        console_rx_head = head;
+    }
+
+    WRITE_PERI_REG(UART_INT_CLR(CONSOLE_UART), st);
+    // UART1 shares the interrupt.
+    if (console_uart1_intr) {
+        console_uart1_intr(console_uart1_arg);
+    } else {
+        WRITE_PERI_REG(UART_INT_CLR(1), READ_PERI_REG(UART_INT_ST(1)));
+    }
+
+    if (console_rx_cb && console_rx_head != console_rx_tail) {
+        console_rx_cb(console_rx_arg);
+    }
+}
+
+static void ICACHE_FLASH_ATTR console_help(void) {
+    for (const struct console_command *cmd = console_commands; cmd->name; ++cmd) {
+        ets_printf("  %s: %s\n", cmd->name, cmd->help);
+    }
+}
+
+static void ICACHE_FLASH_ATTR console_run_line(char *line) {
+    char *argv[CONSOLE_MAX_ARGS];
+    int argc = 0;
+
+    for (char *p = line; *p;) {
+        while (*p == ' ' || *p == '\t') {
+            *p++ = '\0';
+        }
+        if (!*p) {
+            break;
+        }
+        if (argc == CONSOLE_MAX_ARGS) {
+            ets_printf("too many arguments\n");
+            return;
+        }
+        argv[argc++] = p;
+        while (*p && *p != ' ' && *p != '\t') {
+            ++p;
+        }
+    }
+
+    if (!argc) {
+        return;
+    }
+
+    if (!os_strcmp(argv[0], "help")) {
+        console_help();
+        return;
+    }
+
+    for (const struct console_command *cmd = console_commands; cmd->name; ++cmd) {
+        if (!os_strcmp(argv[0], cmd->name)) {
+            cmd->fn(argc, argv);
+            return;
+        }
+    }
+
+    ets_printf("unknown command: %s (try help)\n", argv[0]);
+}
+
+#if CONSOLE_UDP_PORT
+/**
+ * Run each line of a datagram. They are copied out, so the datagram is left as it is.
+ */
+static void ICACHE_FLASH_ATTR console_udp_recv(void *arg, char *pdata, unsigned short len) {
+    char line[CONSOLE_LINE_LEN];
+    uint8_t n = 0;
+    bool overflow = false;
+
+    for (const char *p = pdata, *end = pdata + len; p <= end; ++p) {
+        if (p == end || *p == '\r' || *p == '\n') {
+            if (overflow) {
+                ets_printf("line too long\n");
+            } else {
+                line[n] = '\0';
+                console_run_line(line);
+            }
+            n = 0;
+            overflow = false;
+        } else if (n < sizeof(line) - 1) {
+            line[n++] = *p;
+        } else {
+            overflow = true;
+        }
+    }
+}
+#endif
+
+void ICACHE_FLASH_ATTR console_init(const struct console_command *commands, void (*rx_cb)(void *arg), void *arg) {
+    console_commands = commands;
+    console_rx_cb = rx_cb;
+    console_rx_arg = arg;
+    console_rx_head = 0;
+    console_rx_tail = 0;
+    console_rx_dropped = 0;
+    console_line_len = 0;
+    console_line_overflow = false;
+
+    ETS_UART_INTR_DISABLE();
+    ETS_UART_INTR_ATTACH(console_intr, NULL);
+
+    SET_PERI_REG_MASK(UART_CONF0(CONSOLE_UART), UART_RXFIFO_RST);
+    CLEAR_PERI_REG_MASK(UART_CONF0(CONSOLE_UART), UART_RXFIFO_RST);
+    WRITE_PERI_REG(UART_CONF1(CONSOLE_UART),
+                   (CONSOLE_RXFIFO_FULL_THRHD << UART_RXFIFO_FULL_THRHD_S) |
+                       (CONSOLE_RX_TOUT_THRHD << UART_RX_TOUT_THRHD_S) | UART_RX_TOUT_EN);
+    WRITE_PERI_REG(UART_INT_CLR(CONSOLE_UART), 0xFFFF);
+    WRITE_PERI_REG(UART_INT_ENA(CONSOLE_UART), UART_RXFIFO_FULL_INT | UART_RXFIFO_TOUT_INT);
+
+    ETS_UART_INTR_ENABLE();
+
+#if CONSOLE_UDP_PORT
+    os_memset(&console_conn, 0, sizeof(console_conn));
+    os_memset(&console_udp, 0, sizeof(console_udp));
+    console_udp.local_port = CONSOLE_UDP_PORT;
+    console_conn.type = ESPCONN_UDP;
+    console_conn.proto.udp = &console_udp;
+    espconn_regist_recvcb(&console_conn, console_udp_recv);
+    if (espconn_create(&console_conn)) {
+        ets_printf("console: can't listen on UDP port %d\n", CONSOLE_UDP_PORT);
+    }
+#endif
+}
+
+void ICACHE_FLASH_ATTR console_set_uart1_intr(void (*fn)(void *arg), void *arg) {
+    ETS_UART_INTR_DISABLE();
+    console_uart1_intr = fn;
+    console_uart1_arg = arg;
+    ETS_UART_INTR_ENABLE();
+}
+
+void ICACHE_FLASH_ATTR console_process(void) {
+    uint8_t tail = console_rx_tail;
+    uint8_t head = console_rx_head;
+
+    for (; tail != head; ++tail) {
+        char c = console_rx_buf[tail & CONSOLE_RX_BUF_MASK];
+
+        switch (c) {
+        case '\r':
+        case '\n':
+            if (console_line_overflow) {
+                ets_printf("line too long\n");
+            } else {
+                console_line[console_line_len] = '\0';
+                console_run_line(console_line);
+            }
+            console_line_len = 0;
+            console_line_overflow = false;
+            break;
+
+        case '\b':
+        case 0x7F:
+            if (console_line_len) {
+                --console_line_len;
+            }
+            break;
+
+        default:
+            if (console_line_len < sizeof(console_line) - 1) {
+                console_line[console_line_len++] = c;
+            } else {
+                console_line_overflow = true;
+            }
+            break;
+        }
+    }
+
+    console_rx_tail = tail;
+}
+
+uint32_t ICACHE_FLASH_ATTR console_dropped(void) { return console_rx_dropped; }
@@ -0,0 +1,79 @@
+#ifndef SUBSPACE_SIGN_CONSOLE_H
+#define SUBSPACE_SIGN_CONSOLE_H
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef CONSOLE_RX_BUF_SIZE
+/**
+ * Size of the receive ring buffer, in bytes. Must be a power of two, at most 128.
+ */
+#define CONSOLE_RX_BUF_SIZE 64
+#endif
+
+#ifndef CONSOLE_LINE_LEN
+/**
+ * Maximum length of a command line, including the terminating NUL. Longer lines are discarded.
+ */
+#define CONSOLE_LINE_LEN 64
+#endif
+
+#ifndef CONSOLE_UDP_PORT
+/**
+ * A UDP port that also takes commands, one or more lines per datagram, e.g. echo stats | nc -u -w1 <address> 2323.
+ * Output still goes to UART0. 0 disables it.
+ *
+ * With the I2S LED driver, this is the only way in, as U0RXD carries the LED data. Anyone on the network can use it.
+ */
+#define CONSOLE_UDP_PORT 2323
+#endif
+
+#ifndef CONSOLE_MAX_ARGS
+/**
+ * Maximum number of words in a command line, including the command name.
+ */
+#define CONSOLE_MAX_ARGS 4
+#endif
+
+/* --- Types --- */
+struct console_command {
+    const char *name;
+    const char *help;
+    void (*fn)(int argc, char **argv);
+};
+
+/* --- Functions --- */
+/**
+ * Take over the UART0 receive interrupt, and listen on CONSOLE_UDP_PORT.
+ *
+ * Received bytes are queued by the interrupt handler, which then calls rx_cb. Lines are parsed and dispatched by
+ * console_process. Datagrams are run as they arrive.
+ *
+ * @param commands the commands, terminated by an entry with a NULL name. Must outlive the console.
+ * @param rx_cb called from the interrupt handler when bytes have been queued. Must be in IRAM.
+ * @param arg passed to rx_cb.
+ */
+extern void ICACHE_FLASH_ATTR console_init(const struct console_command *commands, void (*rx_cb)(void *arg),
+                                           void *arg);
+
+/**
+ * Set a handler for UART1 interrupts, which share the interrupt with UART0. Without one, they are only acknowledged.
+ *
+ * @param fn the handler. Must be in IRAM.
+ * @param arg passed to fn.
+ */
+extern void ICACHE_FLASH_ATTR console_set_uart1_intr(void (*fn)(void *arg), void *arg);
+
+/**
+ * Consume queued bytes, and run the commands of any complete lines.
+ *
+ * Must be called from task context.
+ */
+extern void ICACHE_FLASH_ATTR console_process(void);
+
+/**
+ * Return the number of received bytes dropped because the ring buffer was full.
+ */
+extern uint32_t ICACHE_FLASH_ATTR console_dropped(void);
+
+#endif /* SUBSPACE_SIGN_CONSOLE_H */
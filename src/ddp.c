@@ -0,0 +1,191 @@
+/**
+ * A DDP (Distributed Display Protocol) receiver, for driving the ring from a media server.
+ *
+ * Each packet carries RGB bytes for a byte offset into the display. They are decoded from the buffer espconn hands
+ * over straight into the output's buffer, with no staging copy. A frame is complete when a packet has the push flag, or
+ * reaches the end of the buffer, for senders that never push.
+ *
+ * The destination ID picks the output: 1 is the first, 2 the second, and so on, and 255 is all of them. Each output
+ * keeps being driven by DDP until the stream times out.
+ *
+ * DDP has a 4-bit sequence number, where zero means it is not used. A packet more than half the sequence space behind
+ * the last one is late, and dropped, so reordered packets can't overwrite newer pixels.
+ */
+#include <espconn.h>
+#include <osapi.h>
+
+#include "ddp.h"
+#include "output.h"
+
+/* --- Macros --- */
+#define DDP_HEADER_LEN 10
+#define DDP_TIMECODE_LEN 4
+#define DDP_VERSION_MASK 0xC0
+#define DDP_VERSION_1 0x40
+#define DDP_FLAG_TIMECODE 0x10
+#define DDP_FLAG_REPLY 0x04
+#define DDP_FLAG_QUERY 0x02
+#define DDP_FLAG_PUSH 0x01
+#define DDP_SEQ_MASK 0x0F
+#define DDP_SEQ_RANGE 15 // Sequence numbers run from 1 to 15
+#define DDP_TYPE_UNDEFINED 0x00
+#define DDP_TYPE_RGB_LEGACY 0x01 // Sent by older senders
+#define DDP_TYPE_RGB8 0x0B       // RGB, 8 bits per channel
+#define DDP_ID_DISPLAY 1
+#define DDP_ID_ALL 255
+
+#if OUTPUT_MAX > 8
+#error "ddp_outputs has a bit per output"
+#endif
+
+/* --- Data --- */
+static struct espconn ddp_conn;
+static esp_udp ddp_udp;
+static void (*ddp_frame_cb)(void *arg);
+static void *ddp_frame_arg;
+static struct ddp_stats ddp_stats_;
+static bool ddp_received;      // Whether a packet has been accepted, and not yet timed out
+static uint32_t ddp_last_time; // system_get_time of the last accepted packet
+static uint8_t ddp_last_seq;   // Zero if not known
+static uint8_t ddp_outputs;    // A bit for each output written since the stream started
+
+// The bit position of R, G and B in a 0x00GGRRBB pixel.
+static const uint8_t DDP_CHANNEL_SHIFTS[3] = {8, 16, 0};
+
+/* --- Functions --- */
+/**
+ * Return whether a sequence number is ahead of the last one.
+ */
+static bool ICACHE_FLASH_ATTR ddp_seq_ok(uint8_t seq) {
+    if (!seq || !ddp_last_seq) {
+        return true;
+    }
+    int8_t d = seq - ddp_last_seq;
+    if (d <= 0) {
+        d += DDP_SEQ_RANGE;
+    }
+    return d < DDP_SEQ_RANGE / 2 + 1;
+}
+
+/**
+ * Decode RGB bytes at a byte offset into a buffer of len LEDs, clipped to its end.
+ */
+static void ICACHE_FLASH_ATTR ddp_write(uint32_t *buf, uint16_t len, uint32_t offset, const uint8_t *data, uint16_t n) {
+    uint32_t end = (uint32_t)len * 3;
+    if (offset >= end) {
+        return;
+    }
+    if (n > end - offset) {
+        n = end - offset;
+    }
+
+    uint32_t *px = buf + offset / 3;
+    uint8_t ch = offset % 3;
+    for (; n && ch; --n, ++data) {
+        uint8_t shift = DDP_CHANNEL_SHIFTS[ch];
+        *px = (*px & ~(0xFFu << shift)) | ((uint32_t)*data << shift);
+        if (++ch == 3) {
+            ch = 0;
+            ++px;
+        }
+    }
+    for (; n >= 3; n -= 3, data += 3) {
+        *px++ = ((uint32_t)data[1] << 16) | ((uint32_t)data[0] << 8) | data[2];
+    }
+    for (; n; --n, ++data, ++ch) {
+        uint8_t shift = DDP_CHANNEL_SHIFTS[ch];
+        *px = (*px & ~(0xFFu << shift)) | ((uint32_t)*data << shift);
+    }
+}
+
+static void ICACHE_FLASH_ATTR ddp_recv(void *arg, char *pdata, unsigned short len) {
+    const uint8_t *p = (const uint8_t *)pdata;
+
+    if (len < DDP_HEADER_LEN || (p[0] & DDP_VERSION_MASK) != DDP_VERSION_1 ||
+        (p[0] & (DDP_FLAG_QUERY | DDP_FLAG_REPLY))) {
+        ++ddp_stats_.bad_packets;
+        return;
+    }
+    if ((p[2] != DDP_TYPE_UNDEFINED && p[2] != DDP_TYPE_RGB_LEGACY && p[2] != DDP_TYPE_RGB8) ||
+        ((p[3] < DDP_ID_DISPLAY || p[3] >= DDP_ID_DISPLAY + output_count()) && p[3] != DDP_ID_ALL)) {
+        ++ddp_stats_.bad_packets;
+        return;
+    }
+
+    uint8_t header_len = DDP_HEADER_LEN + (p[0] & DDP_FLAG_TIMECODE ? DDP_TIMECODE_LEN : 0);
+    uint32_t offset = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+    uint16_t data_len = ((uint16_t)p[8] << 8) | p[9];
+    if (len < header_len + data_len) {
+        ++ddp_stats_.bad_packets;
+        return;
+    }
+
+    // A stream that comes back after a timeout may have restarted its sequence.
+    if (!ddp_is_streaming()) {
+        ddp_last_seq = 0;
+    }
+    uint8_t seq = p[1] & DDP_SEQ_MASK;
+    if (!ddp_seq_ok(seq)) {
+        ++ddp_stats_.out_of_order;
+        return;
+    }
+    if (seq) {
+        ddp_last_seq = seq;
+    }
+    ddp_received = true;
+    ddp_last_time = system_get_time();
+    ++ddp_stats_.packets;
+
+    bool end = false;
+    for (uint8_t i = 0; i < output_count(); ++i) {
+        if (p[3] != DDP_ID_ALL && i != p[3] - DDP_ID_DISPLAY) {
+            continue;
+        }
+        struct output *out = output_get(i);
+        ddp_write(out->buf, out->len, offset, p + header_len, data_len);
+        ddp_outputs |= 1 << i;
+        end |= offset + data_len >= (uint32_t)out->len * 3;
+    }
+
+    if ((p[0] & DDP_FLAG_PUSH) || end) {
+        ++ddp_stats_.frames;
+        if (ddp_frame_cb) {
+            ddp_frame_cb(ddp_frame_arg);
+        }
+    }
+}
+
+bool ICACHE_FLASH_ATTR ddp_init(void (*frame_cb)(void *arg), void *arg) {
+    ddp_frame_cb = frame_cb;
+    ddp_frame_arg = arg;
+    os_memset(&ddp_stats_, 0, sizeof(ddp_stats_));
+    ddp_received = false;
+    ddp_last_seq = 0;
+    ddp_outputs = 0;
+
+    os_memset(&ddp_conn, 0, sizeof(ddp_conn));
+    os_memset(&ddp_udp, 0, sizeof(ddp_udp));
+    ddp_udp.local_port = DDP_PORT;
+    ddp_conn.type = ESPCONN_UDP;
+    ddp_conn.proto.udp = &ddp_udp;
+    espconn_regist_recvcb(&ddp_conn, ddp_recv);
+    return espconn_create(&ddp_conn) == 0;
+}
+
+bool ICACHE_FLASH_ATTR ddp_is_streaming(void) {
+    if (!ddp_received) {
+        return false;
+    }
+    // system_get_time wraps every 71.6 minutes, so forget the last packet once it has timed out, or it would look
+    // recent again a wrap later.
+    if (system_get_time() - ddp_last_time >= DDP_TIMEOUT * 1000) {
+        ddp_received = false;
+        ddp_outputs = 0;
+        return false;
+    }
+    return true;
+}
+
+bool ICACHE_FLASH_ATTR ddp_is_streaming_to(uint8_t output) { return ddp_is_streaming() && (ddp_outputs & 1 << output); }
+
+struct ddp_stats *ICACHE_FLASH_ATTR ddp_stats(void) { return &ddp_stats_; }
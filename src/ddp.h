@@ -0,0 +1,65 @@
+#ifndef SUBSPACE_SIGN_DDP_H
+#define SUBSPACE_SIGN_DDP_H
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef DDP_PORT
+/**
+ * The UDP port to listen on. 4048 is the standard DDP port.
+ */
+#define DDP_PORT 4048
+#endif
+
+#ifndef DDP_TIMEOUT
+/**
+ * How long after the last packet the stream is considered gone, in ms.
+ */
+#define DDP_TIMEOUT 2000
+#endif
+
+/* --- Types --- */
+/**
+ * The caller may reset these at any time.
+ */
+struct ddp_stats {
+    uint32_t packets;      // Accepted packets
+    uint32_t frames;       // Frames completed by a push or by reaching the end of the buffer
+    uint32_t bad_packets;  // Malformed, queries, or for another data type or destination
+    uint32_t out_of_order; // Packets dropped because their sequence number was behind
+};
+
+/* --- Functions --- */
+/**
+ * Start listening for DDP (Distributed Display Protocol) pixel data.
+ *
+ * Payloads are decoded straight from the network buffer into the buf of the output with the packet's destination ID,
+ * as 0x00GGRRBB. ID 1 is the first output, and 255 is all of them. The outputs must already be added. Nothing is drawn
+ * until a frame is complete, and nothing is committed here; frame_cb is called instead.
+ *
+ * @param frame_cb the function to call when a frame is complete, in task context.
+ * @param arg the argument to pass to frame_cb.
+ * @return true on success.
+ */
+extern bool ICACHE_FLASH_ATTR ddp_init(void (*frame_cb)(void *arg), void *arg);
+
+/**
+ * Return whether a packet has been received within DDP_TIMEOUT.
+ *
+ * Must be called at least once every 71 minutes, while system_get_time hasn't wrapped, to notice the timeout.
+ */
+extern bool ICACHE_FLASH_ATTR ddp_is_streaming(void);
+
+/**
+ * Return whether the stream has written to an output since it started, and hasn't timed out.
+ *
+ * @param output the output's number.
+ */
+extern bool ICACHE_FLASH_ATTR ddp_is_streaming_to(uint8_t output);
+
+/**
+ * Return the receiver statistics.
+ */
+extern struct ddp_stats *ICACHE_FLASH_ATTR ddp_stats(void);
+
+#endif /* SUBSPACE_SIGN_DDP_H */
@@ -0,0 +1,136 @@
+/**
+ * A registry of effects, with crossfades between them.
+ *
+ * There are two state arenas. The running effect uses one, and an incoming effect is initialized in the other. During a
+ * transition, the outgoing effect renders into a buffer of its own, the incoming one into the output, and the two are
+ * blended. The outgoing effect is torn down when the transition ends.
+ *
+ * Effects declare what they cost per LED, so a transition that wouldn't fit the render budget can be turned into a cut
+ * before it starts overrunning.
+ */
+#include <osapi.h>
+
+#include "compose.h"
+#include "effect.h"
+
+/* --- Macros --- */
+// Transition progress is in 1/256 of alpha.
+#define EFFECT_PROGRESS_END (256 << 8)
+
+/* --- Data --- */
+static const struct effect *effects[EFFECT_MAX];
+static uint8_t num_effects;
+static uint32_t effect_arenas[2][(EFFECT_STATE_SIZE + 3) / 4];
+static uint32_t effect_from_buf[EFFECT_MAX_LEDS];
+static uint32_t *effect_out;
+static uint16_t effect_len;
+static uint32_t effect_budget;           // Cycles per frame
+static const struct effect *effect_to;   // The running or incoming effect
+static const struct effect *effect_from; // The outgoing effect, or NULL if there is no transition
+static uint8_t effect_to_arena;          // The arena of effect_to. effect_from has the other.
+static uint32_t effect_progress;         // Of the transition, up to EFFECT_PROGRESS_END
+static uint32_t effect_step;             // Progress per frame
+
+/* --- Functions --- */
+static void ICACHE_FLASH_ATTR effect_teardown(const struct effect *effect, uint8_t arena) {
+    if (effect->teardown) {
+        effect->teardown(effect_arenas[arena]);
+    }
+}
+
+bool ICACHE_FLASH_ATTR effect_init(uint32_t *out, uint16_t len, uint32_t budget) {
+    if (!len || len > EFFECT_MAX_LEDS) {
+        return false;
+    }
+
+    effect_out = out;
+    effect_len = len;
+    effect_budget = budget;
+    effect_to = NULL;
+    effect_from = NULL;
+    num_effects = 0;
+
+    return true;
+}
+
+bool ICACHE_FLASH_ATTR effect_register(const struct effect *effect) {
+    if (num_effects == EFFECT_MAX || effect->state_size > EFFECT_STATE_SIZE) {
+        return false;
+    }
+
+    effects[num_effects++] = effect;
+    return true;
+}
+
+uint8_t ICACHE_FLASH_ATTR effect_count(void) { return num_effects; }
+
+const struct effect *ICACHE_FLASH_ATTR effect_get(uint8_t i) { return effects[i]; }
+
+const struct effect *ICACHE_FLASH_ATTR effect_find(const char *name) {
+    for (uint8_t i = 0; i < num_effects; ++i) {
+        if (!os_strcmp(effects[i]->name, name)) {
+            return effects[i];
+        }
+    }
+    return NULL;
+}
+
+const struct effect *ICACHE_FLASH_ATTR effect_current(void) { return effect_to; }
+
+bool ICACHE_FLASH_ATTR effect_fits(const struct effect *a, const struct effect *b) {
+    uint32_t cost = a->cost + (b ? b->cost + EFFECT_BLEND_COST : 0);
+    return cost * effect_len <= effect_budget;
+}
+
+bool ICACHE_FLASH_ATTR effect_switch(const struct effect *effect, uint16_t frames) {
+    if (effect == effect_to) {
+        return true;
+    }
+
+    if (effect_from) {
+        effect_teardown(effect_from, !effect_to_arena);
+        effect_from = NULL;
+    }
+
+    uint8_t arena = !effect_to_arena;
+    os_memset(effect_arenas[arena], 0, sizeof(effect_arenas[arena]));
+    if (effect->init && !effect->init(effect_arenas[arena], effect_len)) {
+        return false;
+    }
+
+    if (effect_to && frames && effect_fits(effect_to, effect)) {
+        effect_from = effect_to;
+        effect_progress = 0;
+        effect_step = EFFECT_PROGRESS_END / frames;
+    } else if (effect_to) {
+        effect_teardown(effect_to, effect_to_arena);
+    }
+    effect_to = effect;
+    effect_to_arena = arena;
+
+    return true;
+}
+
+void ICACHE_FLASH_ATTR effect_render(void) {
+    if (!effect_to) {
+        return;
+    }
+
+    effect_to->render(effect_arenas[effect_to_arena], effect_out, effect_len);
+    if (!effect_from) {
+        return;
+    }
+
+    effect_progress += effect_step;
+    if (effect_progress >= EFFECT_PROGRESS_END) {
+        effect_teardown(effect_from, !effect_to_arena);
+        effect_from = NULL;
+        return;
+    }
+
+    effect_from->render(effect_arenas[!effect_to_arena], effect_from_buf, effect_len);
+    uint16_t alpha = effect_progress >> 8;
+    for (uint16_t i = 0; i < effect_len; ++i) {
+        effect_out[i] = compose_alpha(effect_out[i], effect_from_buf[i], alpha);
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef SUBSPACE_SIGN_EFFECT_H
+#define SUBSPACE_SIGN_EFFECT_H
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef EFFECT_MAX
+/**
+ * The maximum number of registered effects.
+ */
+#define EFFECT_MAX 8
+#endif
+
+#ifndef EFFECT_MAX_LEDS
+/**
+ * The largest ring size. Each LED costs four bytes for the outgoing effect during a transition.
+ */
+#define EFFECT_MAX_LEDS 120
+#endif
+
+#ifndef EFFECT_STATE_SIZE
+/**
+ * The size of each effect state arena, in bytes. There are two, for the effects on either side of a transition.
+ */
+#define EFFECT_STATE_SIZE 64
+#endif
+
+/**
+ * The cost of blending two effects during a transition, in cycles per LED.
+ */
+#define EFFECT_BLEND_COST 24
+
+/* --- Types --- */
+/**
+ * An effect that draws the whole ring every frame.
+ */
+struct effect {
+    const char *name;
+    uint16_t state_size;                                      // Bytes of arena needed, at most EFFECT_STATE_SIZE
+    uint16_t cost;                                            // Cycles per LED per frame, as in the render profile
+    bool (*init)(void *state, uint16_t len);                  // May be NULL. The arena is cleared first.
+    void (*render)(void *state, uint32_t *buf, uint16_t len); // Must write every LED
+    void (*teardown)(void *state);                            // May be NULL
+};
+
+/* --- Functions --- */
+/**
+ * Initialize the registry. No effect is running until effect_switch is called.
+ *
+ * @param out the buffer to render into.
+ * @param len the number of LEDs. At most EFFECT_MAX_LEDS.
+ * @param budget the render time per frame, in CPU cycles.
+ * @return true on success.
+ */
+extern bool ICACHE_FLASH_ATTR effect_init(uint32_t *out, uint16_t len, uint32_t budget);
+
+/**
+ * Register an effect. Effects are listed in the order they are registered.
+ *
+ * @param effect the effect. Must outlive the registry.
+ * @return false if the registry is full, or the state doesn't fit in an arena.
+ */
+extern bool ICACHE_FLASH_ATTR effect_register(const struct effect *effect);
+
+/**
+ * Return the number of registered effects.
+ */
+extern uint8_t ICACHE_FLASH_ATTR effect_count(void);
+
+/**
+ * Return the registered effect with the given number.
+ */
+extern const struct effect *ICACHE_FLASH_ATTR effect_get(uint8_t i);
+
+/**
+ * Return the registered effect with the given name, or NULL.
+ */
+extern const struct effect *ICACHE_FLASH_ATTR effect_find(const char *name);
+
+/**
+ * Return the effect running, or being transitioned to. NULL before the first effect_switch.
+ */
+extern const struct effect *ICACHE_FLASH_ATTR effect_current(void);
+
+/**
+ * Return whether two effects can be rendered and blended within the budget, e.g. during a transition.
+ *
+ * @param a an effect.
+ * @param b another effect, or NULL to check a on its own.
+ */
+extern bool ICACHE_FLASH_ATTR effect_fits(const struct effect *a, const struct effect *b);
+
+/**
+ * Switch to another effect, crossfading over the given number of frames.
+ *
+ * If the two effects don't fit the budget together, or no effect is running, the switch is a cut. If a transition is
+ * already running, its outgoing effect is dropped, and the new transition starts from the incoming one.
+ *
+ * @param effect the effect to switch to.
+ * @param frames the length of the crossfade. Zero cuts.
+ * @return false if the effect failed to initialize. The current effect then keeps running.
+ */
+extern bool ICACHE_FLASH_ATTR effect_switch(const struct effect *effect, uint16_t frames);
+
+/**
+ * Render the next frame into the output buffer.
+ */
+extern void ICACHE_FLASH_ATTR effect_render(void);
+
+#endif /* SUBSPACE_SIGN_EFFECT_H */
@@ -0,0 +1,186 @@
+/**
+ * Several WS2811 chains driven together, each by its own driver and back buffer.
+ *
+ * All outputs are committed at once, and the frame-done callback runs when the last one has finished, so a single frame
+ * scheduler can pace them all.
+ *
+ * Each output only clears its own busy flag, and then checks the others. A driver's interrupt handler may run in the
+ * middle of another driver's check (the GPIO driver checks from a timer), but whichever finishes last sees all flags
+ * clear, so the callback is never missed. If both see them clear, it runs twice, which pipeline_post already coalesces.
+ *
+ * A static clock produces the same frame most of the time, so each back buffer is hashed before committing. If it is
+ * unchanged, the driver is left idle, apart from a keep-alive.
+ *
+ * The hash is of the frame as rendered, before grading. Outputs whose driver can't grade are drawn into a separate
+ * buffer and graded into the back buffer on commit, so static frames stay comparable. A graded frame with levels
+ * between output steps is still sent every frame, as skipping it would slow the dithering down to the keep-alive.
+ */
+#include <osapi.h>
+
+#include "output.h"
+
+/* --- Macros --- */
+#define OUTPUT_FNV_OFFSET 2166136261u
+#define OUTPUT_FNV_PRIME 16777619u
+
+/* --- Data --- */
+static struct output outputs[OUTPUT_MAX];
+static uint8_t num_outputs;
+static void (*output_frame_done_cb)(void *arg);
+static void *output_frame_done_arg;
+
+/**
+ * Called from each driver's interrupt handler or frame done timer when a frame has been sent.
+ *
+ * Must be in IRAM.
+ */
+static void output_frame_done(void *arg) {
+    struct output *out = (struct output *)arg;
+
+    out->busy = false;
+    for (uint8_t i = 0; i < num_outputs; ++i) {
+        if (outputs[i].busy) {
+            return;
+        }
+    }
+
+    if (output_frame_done_cb) {
+        output_frame_done_cb(output_frame_done_arg);
+    }
+}
+
+/**
+ * FNV-1a, one pixel at a time instead of one byte, which is plenty to tell frames apart.
+ */
+static uint32_t ICACHE_FLASH_ATTR output_hash(const uint32_t *buf, uint16_t len) {
+    uint32_t h = OUTPUT_FNV_OFFSET;
+    for (const uint32_t *end = buf + len; buf != end; ++buf) {
+        h = (h ^ *buf) * OUTPUT_FNV_PRIME;
+    }
+    return h;
+}
+
+#if OUTPUT_DITHER
+/**
+ * Return whether any level of an output's frame falls between two output steps, so it has to be dithered.
+ */
+static bool ICACHE_FLASH_ATTR output_fractional(const struct output *out) {
+    const uint16_t *lut = out->grade->lut;
+    for (const uint32_t *p = out->buf, *end = out->buf + out->len; p != end; ++p) {
+        uint32_t v = *p;
+        for (int i = 0; i < WS2811_GRADE_CHANNELS; ++i, v >>= 8) {
+            if (lut[v & 0xFF] & 0xFF) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+#endif
+
+struct output *ICACHE_FLASH_ATTR output_add(const char *name, const struct output_ops *ops, void *ctx, uint16_t len) {
+    if (num_outputs == OUTPUT_MAX) {
+        return NULL;
+    }
+
+    struct output *out = &outputs[num_outputs];
+    out->name = name;
+    out->ops = ops;
+    out->ctx = ctx;
+    out->back = ops->back_buffer(ctx);
+    out->buf = out->back;
+    out->len = len;
+    out->busy = false;
+    out->skipped_frames = 0;
+    out->grade = NULL;
+    out->residual = NULL;
+    out->fractional = false;
+    os_memset(out->buf, 0, len * sizeof(*out->buf));
+    // Make sure the first frame is sent.
+    out->hash = ~output_hash(out->buf, len);
+    ops->set_frame_done_cb(ctx, output_frame_done, out);
+    ++num_outputs;
+
+    return out;
+}
+
+uint8_t ICACHE_FLASH_ATTR output_count(void) { return num_outputs; }
+
+struct output *ICACHE_FLASH_ATTR output_get(uint8_t i) { return &outputs[i]; }
+
+void ICACHE_FLASH_ATTR output_set_frame_done_cb(void (*cb)(void *arg), void *arg) {
+    output_frame_done_cb = cb;
+    output_frame_done_arg = arg;
+}
+
+void ICACHE_FLASH_ATTR output_set_grade(struct output *out, struct ws2811_grade *grade, uint8_t *residual,
+                                        uint32_t *render) {
+    out->grade = grade;
+    if (grade) {
+        grade->dither = OUTPUT_DITHER;
+    }
+    if (out->ops->set_grade) {
+        out->ops->set_grade(out->ctx, grade);
+    } else if (grade) {
+        out->residual = residual;
+        os_memset(residual, 0, out->len * WS2811_GRADE_CHANNELS);
+        out->buf = render;
+        os_memset(render, 0, out->len * sizeof(*render));
+    } else {
+        out->buf = out->back;
+    }
+}
+
+uint8_t ICACHE_FLASH_ATTR output_commit_all(void) {
+    uint32_t now = system_get_time();
+    bool dirty[OUTPUT_MAX];
+    uint8_t n = 0;
+
+    // Mark them all busy first, so an output finishing early doesn't trigger the callback on its own.
+    for (uint8_t i = 0; i < num_outputs; ++i) {
+        struct output *out = &outputs[i];
+        uint32_t hash = output_hash(out->buf, out->len);
+        bool changed = hash != out->hash;
+#if OUTPUT_DITHER
+        if (changed) {
+            out->fractional = out->grade && output_fractional(out);
+        }
+#endif
+        dirty[i] = changed || out->fractional || now - out->commit_time >= OUTPUT_KEEPALIVE * 1000;
+        if (!dirty[i]) {
+            ++out->skipped_frames;
+            continue;
+        }
+        out->hash = hash;
+        out->commit_time = now;
+        out->busy = true;
+        ++n;
+    }
+
+    for (uint8_t i = 0; i < num_outputs; ++i) {
+        struct output *out = &outputs[i];
+        if (!dirty[i]) {
+            continue;
+        }
+        if (out->grade && !out->ops->set_grade) {
+            ws2811_grade_apply(out->grade, out->back, out->buf, out->residual, out->len);
+        }
+        out->ops->commit(out->ctx, out->len);
+    }
+
+    return n;
+}
+
+void ICACHE_FLASH_ATTR output_invalidate(void) {
+    for (uint8_t i = 0; i < num_outputs; ++i) {
+        outputs[i].hash = ~output_hash(outputs[i].buf, outputs[i].len);
+    }
+}
+
+uint32_t ICACHE_FLASH_ATTR output_superseded_frames(void) {
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < num_outputs; ++i) {
+        n += outputs[i].ops->superseded_frames(outputs[i].ctx);
+    }
+    return n;
+}
@@ -0,0 +1,167 @@
+#ifndef SUBSPACE_SIGN_OUTPUT_H
+#define SUBSPACE_SIGN_OUTPUT_H
+
+#include <user_interface.h>
+
+#include <ws2811-esp8266-grade.h>
+
+/* --- Macros --- */
+#ifndef OUTPUT_MAX
+/**
+ * The maximum number of outputs.
+ */
+#define OUTPUT_MAX 2
+#endif
+
+#ifndef OUTPUT_KEEPALIVE
+/**
+ * Unchanged frames are still sent this often, in ms, in case a LED picked up a glitch.
+ */
+#define OUTPUT_KEEPALIVE 1000
+#endif
+
+#ifndef OUTPUT_DITHER
+/**
+ * Whether graded outputs are dithered. A frame with levels between two output steps is then sent every frame, even if
+ * it hasn't changed, so the dithering runs at the frame rate. The display can't doze while it shows one. If 0, levels
+ * are rounded, and unchanged frames are always skipped.
+ */
+#define OUTPUT_DITHER 1
+#endif
+
+/**
+ * Define a struct output_ops called name for a WS2811 driver.
+ *
+ * All drivers share the same API, with function names starting with prefix, and a superseded_frames field.
+ *
+ * @param name the name of the ops table.
+ * @param type the driver context type.
+ * @param prefix the driver function name prefix, e.g. ws2811_i2s_.
+ */
+#define OUTPUT_DEFINE_OPS(name, type, prefix) OUTPUT_DEFINE_OPS_(name, type, prefix, NULL)
+
+/**
+ * Like OUTPUT_DEFINE_OPS, for a driver that can grade while encoding, with a prefix##set_grade function.
+ */
+#define OUTPUT_DEFINE_GRADED_OPS(name, type, prefix)                                                                   \
+    static void ICACHE_FLASH_ATTR name##_set_grade(void *ctx, const struct ws2811_grade *grade) {                      \
+        prefix##set_grade((type *)ctx, grade);                                                                         \
+    }                                                                                                                  \
+    OUTPUT_DEFINE_OPS_(name, type, prefix, name##_set_grade)
+
+#define OUTPUT_DEFINE_OPS_(name, type, prefix, set_grade)                                                              \
+    static uint32_t *ICACHE_FLASH_ATTR name##_back_buffer(void *ctx) { return prefix##back_buffer((type *)ctx); }      \
+    static void ICACHE_FLASH_ATTR name##_commit(void *ctx, size_t len) { prefix##commit((type *)ctx, len); }           \
+    static void ICACHE_FLASH_ATTR name##_set_frame_done_cb(void *ctx, void (*cb)(void *), void *arg) {                 \
+        prefix##set_frame_done_cb((type *)ctx, cb, arg);                                                               \
+    }                                                                                                                  \
+    static uint32_t ICACHE_FLASH_ATTR name##_superseded_frames(void *ctx) { return ((type *)ctx)->superseded_frames; } \
+    static const struct output_ops name = {                                                                            \
+        name##_back_buffer,                                                                                            \
+        name##_commit,                                                                                                 \
+        name##_set_frame_done_cb,                                                                                      \
+        name##_superseded_frames,                                                                                      \
+        set_grade,                                                                                                     \
+    }
+
+/* --- Types --- */
+/**
+ * The driver functions used by an output. Only set_frame_done_cb needs to be safe against the driver interrupt.
+ */
+struct output_ops {
+    uint32_t *(*back_buffer)(void *ctx);
+    void (*commit)(void *ctx, size_t len);
+    void (*set_frame_done_cb)(void *ctx, void (*cb)(void *), void *arg);
+    uint32_t (*superseded_frames)(void *ctx);
+    void (*set_grade)(void *ctx, const struct ws2811_grade *grade); // NULL if the driver can't grade
+};
+
+struct output {
+    const char *name;
+    const struct output_ops *ops;
+    void *ctx;
+    uint32_t *buf;           // Where frames are drawn. The driver's back buffer, unless graded into it.
+    uint32_t *back;          // The driver's back buffer
+    uint16_t len;            // Number of pixels
+    volatile bool busy;      // Committed, and not yet sent
+    uint32_t hash;           // Of the last committed frame
+    uint32_t commit_time;    // system_get_time of the last commit
+    uint32_t skipped_frames; // Unchanged frames that were not sent
+    struct ws2811_grade *grade;
+    uint8_t *residual; // Dither residuals, if the driver can't grade
+    bool fractional;   // Whether the last changed frame has levels between output steps, if dithered
+};
+
+/* --- Functions --- */
+/**
+ * Add an output. The driver must already be initialized.
+ *
+ * Outputs are numbered in the order they are added. The back buffer is cleared.
+ *
+ * @param name a name for messages. Must outlive the output.
+ * @param ops the driver functions. Must outlive the output.
+ * @param ctx the driver context.
+ * @param len the number of pixels. Must fit in the driver's back buffer.
+ * @return the output, or NULL if there are already OUTPUT_MAX outputs.
+ */
+extern struct output *ICACHE_FLASH_ATTR output_add(const char *name, const struct output_ops *ops, void *ctx,
+                                                   uint16_t len);
+
+/**
+ * Return the number of outputs.
+ */
+extern uint8_t ICACHE_FLASH_ATTR output_count(void);
+
+/**
+ * Return the output with the given number.
+ */
+extern struct output *ICACHE_FLASH_ATTR output_get(uint8_t i);
+
+/**
+ * Set a function to call once every output has sent its last committed frame.
+ *
+ * It may be called from a driver interrupt handler, so it must be in IRAM and should do little more than
+ * system_os_post. Drivers driven by an NMI call it from a timer instead. It may be called more than once per frame.
+ *
+ * @param cb the function to call, or NULL.
+ * @param arg the argument to pass to cb.
+ */
+extern void ICACHE_FLASH_ATTR output_set_frame_done_cb(void (*cb)(void *arg), void *arg);
+
+/**
+ * Set the colour grading of an output. Sets grade->dither from OUTPUT_DITHER.
+ *
+ * If the driver can grade while encoding, it does. Otherwise, frames are drawn into render instead, and graded from
+ * there into the back buffer just before they are committed. Either way, buf is never graded, so pixels that aren't
+ * redrawn keep their value. buf may change here, and render is cleared.
+ *
+ * @param out the output.
+ * @param grade the grading, or NULL for none. Must outlive the output. May be shared between outputs.
+ * @param residual the dither residuals, WS2811_GRADE_CHANNELS bytes per pixel, cleared here.
+ * @param render a buffer of len pixels to draw into.
+ *        residual and render are only used if the driver can't grade, and may otherwise be NULL.
+ */
+extern void ICACHE_FLASH_ATTR output_set_grade(struct output *out, struct ws2811_grade *grade, uint8_t *residual,
+                                               uint32_t *render);
+
+/**
+ * Commit the back buffers of all outputs, so they are sent together.
+ *
+ * Outputs whose buffer hasn't changed since the last commit are skipped, unless OUTPUT_KEEPALIVE has passed or they
+ * are being dithered, and counted in skipped_frames.
+ *
+ * @return the number of outputs committed. If zero, the frame-done callback will not be called for this frame.
+ */
+extern uint8_t ICACHE_FLASH_ATTR output_commit_all(void);
+
+/**
+ * Make every output send its next frame, even if it hasn't changed, e.g. because the grading has.
+ */
+extern void ICACHE_FLASH_ATTR output_invalidate(void);
+
+/**
+ * Return the total number of committed frames that were replaced before being sent, over all outputs.
+ */
+extern uint32_t ICACHE_FLASH_ATTR output_superseded_frames(void);
+
+#endif /* SUBSPACE_SIGN_OUTPUT_H */
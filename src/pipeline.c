@@ -0,0 +1,72 @@
+/**
+ * A render pipeline built on SDK tasks.
+ *
+ * Each stage is a separate task, so the SDK can run Wi-Fi and timer processing between them. Stages are timed against
+ * a budget, and overruns are counted.
+ */
+#include <osapi.h>
+
+#include "pipeline.h"
+
+/* --- Macros --- */
+#define PIPELINE_QUEUE_LEN 2
+
+/* --- Data --- */
+static const uint8_t PIPELINE_PRIOS[PIPELINE_NUM_STAGES] = {
+    USER_TASK_PRIO_0,
+    USER_TASK_PRIO_1,
+    USER_TASK_PRIO_2,
+};
+
+static struct pipeline_stage_config pipeline_configs[PIPELINE_NUM_STAGES];
+static struct pipeline_stage_stats pipeline_stage_stats[PIPELINE_NUM_STAGES];
+static volatile bool pipeline_posted[PIPELINE_NUM_STAGES];
+static os_event_t pipeline_queues[PIPELINE_NUM_STAGES][PIPELINE_QUEUE_LEN];
+
+static void ICACHE_FLASH_ATTR pipeline_task(os_event_t *event) {
+    enum pipeline_stage stage = (enum pipeline_stage)event->sig;
+    const struct pipeline_stage_config *config = &pipeline_configs[stage];
+    struct pipeline_stage_stats *stats = &pipeline_stage_stats[stage];
+
+    // Clear first, so the stage can reschedule itself.
+    pipeline_posted[stage] = false;
+
+    uint32_t start = system_get_time();
+    config->fn(config->arg);
+    uint32_t t = system_get_time() - start;
+
+    ++stats->runs;
+    if (t > stats->max_time) {
+        stats->max_time = t;
+    }
+    if (t > config->budget) {
+        ++stats->overruns;
+    }
+}
+
+bool ICACHE_FLASH_ATTR pipeline_init(const struct pipeline_stage_config *configs) {
+    os_memcpy(pipeline_configs, configs, sizeof(pipeline_configs));
+    os_memset(pipeline_stage_stats, 0, sizeof(pipeline_stage_stats));
+
+    for (int i = 0; i < PIPELINE_NUM_STAGES; ++i) {
+        pipeline_posted[i] = false;
+        if (!system_os_task(pipeline_task, PIPELINE_PRIOS[i], pipeline_queues[i], PIPELINE_QUEUE_LEN)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Must be in IRAM, as it is called from the driver ISR.
+void pipeline_post(enum pipeline_stage stage) {
+    if (pipeline_posted[stage]) {
+        return;
+    }
+    pipeline_posted[stage] = true;
+    system_os_post(PIPELINE_PRIOS[stage], stage, 0);
+}
+
+struct pipeline_stage_stats *ICACHE_FLASH_ATTR pipeline_stats(enum pipeline_stage stage) {
+    return &pipeline_stage_stats[stage];
+}
@@ -0,0 +1,54 @@
+#ifndef SUBSPACE_SIGN_PIPELINE_H
+#define SUBSPACE_SIGN_PIPELINE_H
+
+#include <user_interface.h>
+
+/* --- Types --- */
+/**
+ * The pipeline stages, in increasing priority. Each runs as its own SDK task.
+ */
+enum pipeline_stage {
+    PIPELINE_INPUT,    // Console and other input
+    PIPELINE_RENDER,   // Drawing the next frame into the back buffer
+    PIPELINE_TRANSMIT, // Committing the back buffer to the driver
+    PIPELINE_NUM_STAGES,
+};
+
+struct pipeline_stage_config {
+    void (*fn)(void *arg);
+    void *arg;
+    uint32_t budget; // µs
+};
+
+struct pipeline_stage_stats {
+    uint32_t runs;
+    uint32_t overruns; // Runs that took longer than the budget
+    uint32_t max_time; // µs
+};
+
+/* --- Functions --- */
+/**
+ * Register the stage tasks with the SDK.
+ *
+ * @param configs the stage functions and budgets, indexed by enum pipeline_stage.
+ * @return true on success.
+ */
+extern bool ICACHE_FLASH_ATTR pipeline_init(const struct pipeline_stage_config *configs);
+
+/**
+ * Schedule a stage to run. Does nothing if the stage is already scheduled.
+ *
+ * May be called from interrupt handlers.
+ *
+ * @param stage the stage to run.
+ */
+extern void pipeline_post(enum pipeline_stage stage);
+
+/**
+ * Return the run time statistics of a stage. The caller may reset them at any time.
+ *
+ * @param stage the stage.
+ */
+extern struct pipeline_stage_stats *ICACHE_FLASH_ATTR pipeline_stats(enum pipeline_stage stage);
+
+#endif /* SUBSPACE_SIGN_PIPELINE_H */
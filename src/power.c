@@ -0,0 +1,90 @@
+/**
+ * Light sleep while the display is static.
+ *
+ * With the SDK's automatic light sleep, the chip sleeps whenever it is idle and no timer is due soon. That only helps
+ * if the frame timer stops firing at the frame rate, so once frames stop changing, the next one is pushed out to just
+ * before the next second boundary, when the clock's second hand moves.
+ *
+ * SNTP only gives whole seconds, so the boundary is learned as the system time at which the SNTP second last changed,
+ * as seen by frames rendered at the normal rate. Waking POWER_WAKE_LEAD early and rendering normally until the change
+ * refreshes it every second, so it follows drift. If the second has already changed on waking, the estimate is too
+ * late, e.g. after an SNTP update, and it is relearned at the normal frame rate.
+ */
+#include <osapi.h>
+#include <sntp.h>
+
+#include "power.h"
+
+/* --- Macros --- */
+#define POWER_SECOND 1000000 // µs
+
+/* --- Data --- */
+static struct power_stats power_stats_;
+static uint32_t power_prev_second;     // SNTP timestamp at the previous frame
+static uint32_t power_second_time;     // system_get_time of the last second boundary
+static bool power_second_valid;        // Whether power_second_time is known
+static bool power_second_seen;         // Whether the second has changed since the last wake-up
+static uint8_t power_idle_frames;      // Unchanged frames in a row, up to POWER_IDLE_FRAMES
+static bool power_dozing;              // Whether light sleep is enabled
+static bool power_dozed_last;          // Whether the previous frame was followed by a doze
+
+void ICACHE_FLASH_ATTR power_init(void) {
+    os_memset(&power_stats_, 0, sizeof(power_stats_));
+    power_prev_second = 0;
+    power_second_valid = false;
+    power_second_seen = false;
+    power_idle_frames = 0;
+    power_dozing = false;
+    power_dozed_last = false;
+    wifi_set_sleep_type(MODEM_SLEEP_T);
+}
+
+void ICACHE_FLASH_ATTR power_frame(bool sent, uint32_t *next_frame_time) {
+    uint32_t now = system_get_time();
+    uint32_t second = sntp_get_current_timestamp();
+
+    if (second != power_prev_second) {
+        // After a frame at the normal rate, the boundary is known to within a frame period.
+        power_second_valid = power_prev_second && second && !power_dozed_last;
+        if (power_second_valid) {
+            power_second_time = now;
+        }
+        power_second_seen = true;
+        power_prev_second = second;
+    }
+    power_dozed_last = false;
+
+    if (sent) {
+        power_idle_frames = 0;
+        if (power_dozing) {
+            wifi_set_sleep_type(MODEM_SLEEP_T);
+            power_dozing = false;
+        }
+        return;
+    }
+
+    if (power_idle_frames < POWER_IDLE_FRAMES) {
+        ++power_idle_frames;
+    }
+    if (power_idle_frames < POWER_IDLE_FRAMES || !second || !power_second_valid || !power_second_seen) {
+        return;
+    }
+
+    uint32_t next_second = power_second_time + ((now - power_second_time) / POWER_SECOND + 1) * POWER_SECOND;
+    uint32_t wake = next_second - POWER_WAKE_LEAD;
+    if ((int32_t)(wake - *next_frame_time) <= 0) {
+        return;
+    }
+
+    if (!power_dozing) {
+        wifi_set_sleep_type(LIGHT_SLEEP_T);
+        power_dozing = true;
+    }
+    ++power_stats_.dozes;
+    power_stats_.doze_time += (wake - now) / 1000;
+    power_second_seen = false;
+    power_dozed_last = true;
+    *next_frame_time = wake;
+}
+
+struct power_stats *ICACHE_FLASH_ATTR power_stats(void) { return &power_stats_; }
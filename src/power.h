@@ -0,0 +1,54 @@
+#ifndef SUBSPACE_SIGN_POWER_H
+#define SUBSPACE_SIGN_POWER_H
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef POWER_IDLE_FRAMES
+/**
+ * Number of unchanged frames in a row before dozing until the next second. Keeps slow animations from stalling.
+ */
+#define POWER_IDLE_FRAMES 2
+#endif
+
+#ifndef POWER_WAKE_LEAD
+/**
+ * How long before the expected second boundary to wake up, in µs. Frames are then rendered at the normal rate until
+ * the second changes, which also keeps the boundary estimate fresh.
+ */
+#define POWER_WAKE_LEAD 20000
+#endif
+
+/* --- Types --- */
+/**
+ * The caller may reset these at any time.
+ */
+struct power_stats {
+    uint32_t dozes;     // Times the display was left static until the next second
+    uint32_t doze_time; // Total time planned for dozing, in ms
+};
+
+/* --- Functions --- */
+/**
+ * Start in modem sleep, the SDK default.
+ */
+extern void ICACHE_FLASH_ATTR power_init(void);
+
+/**
+ * Account for a finished frame, and decide when to render the next one.
+ *
+ * If the display has been static for POWER_IDLE_FRAMES and the SNTP clock is valid, this enables light sleep and moves
+ * next_frame_time to just before the next second boundary. Any frame that is sent switches back to modem sleep, so the
+ * chip never light-sleeps while a driver is sending.
+ *
+ * @param sent whether any output was committed.
+ * @param next_frame_time the system_get_time at which the next frame is due. May be moved later.
+ */
+extern void ICACHE_FLASH_ATTR power_frame(bool sent, uint32_t *next_frame_time);
+
+/**
+ * Return the power statistics.
+ */
+extern struct power_stats *ICACHE_FLASH_ATTR power_stats(void);
+
+#endif /* SUBSPACE_SIGN_POWER_H */
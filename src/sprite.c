@@ -0,0 +1,115 @@
+/**
+ * Sprites moving around a ring of LEDs, e.g. sparks.
+ *
+ * Positions and velocities are 16.16 fixed point, so sprites can move at any speed, and are drawn over two LEDs by
+ * their fractional position. Fading is computed from the age of a sprite rather than step by step, so it doesn't
+ * depend on the frame rate. Nothing in the per-frame loop divides: time is converted with a reciprocal, wrapping around
+ * the ring is a subtraction, and the exponential is a table lookup and a shift.
+ *
+ * The pool is a fixed array, with free sprites on one list and active ones on another.
+ */
+#include <osapi.h>
+
+#include "compose.h"
+#include "sprite.h"
+
+/* --- Macros --- */
+// Multiply µs by this, and shift right by 32, to get 16.16 seconds.
+#define SPRITE_US_TO_Q16 281474977u // 2^48 / 10^6
+// Number of steps per halving in FADE.
+#define SPRITE_FADE_STEPS 32
+// A fade of this many halvings leaves nothing of a channel.
+#define SPRITE_FADE_HALVINGS 9
+
+/* --- Data --- */
+/**
+ * 2^(-i / SPRITE_FADE_STEPS), in 16.16 fixed point. Flash only supports aligned 32-bit loads.
+ */
+static const uint32_t FADE[SPRITE_FADE_STEPS] ICACHE_RODATA_ATTR = {
+    65536, 64132, 62757, 61413, 60097, 58809, 57549, 56316, 55109, 53928, 52773, 51642, 50535, 49452, 48393, 47356,
+    46341, 45348, 44376, 43425, 42495, 41584, 40693, 39821, 38968, 38133, 37316, 36516, 35734, 34968, 34219, 33486,
+};
+
+/* --- Functions --- */
+/**
+ * Return how much of a sprite is left, from 0 to 256.
+ */
+static uint16_t ICACHE_FLASH_ATTR sprite_alpha(const struct sprite *sp) {
+    // 8.8 halvings.
+    uint64_t h = (uint64_t)sp->age * sp->fade >> 16;
+    if (h >= SPRITE_FADE_HALVINGS << 8) {
+        return 0;
+    }
+    return FADE[(h & 0xFF) * SPRITE_FADE_STEPS >> 8] >> (h >> 8) >> 8;
+}
+
+void ICACHE_FLASH_ATTR sprite_pool_init(struct sprite_pool *pool, uint32_t *buf, uint16_t len) {
+    pool->buf = buf;
+    pool->len = SPRITE_LEDS(len);
+    pool->active = NULL;
+    pool->free = NULL;
+    for (uint8_t i = 0; i < SPRITE_MAX; ++i) {
+        pool->sprites[i].next = pool->free;
+        pool->free = &pool->sprites[i];
+    }
+}
+
+struct sprite *ICACHE_FLASH_ATTR sprite_add(struct sprite_pool *pool, int32_t pos, int32_t vel, uint32_t color,
+                                            uint16_t fade) {
+    struct sprite *sp = pool->free;
+    if (!sp) {
+        return NULL;
+    }
+    pool->free = sp->next;
+
+    sp->pos = pos;
+    sp->vel = vel;
+    sp->color = color;
+    sp->age = 0;
+    sp->fade = fade;
+    sp->next = pool->active;
+    pool->active = sp;
+
+    return sp;
+}
+
+void ICACHE_FLASH_ATTR sprite_update(struct sprite_pool *pool, uint32_t dt) {
+    if (dt > SPRITE_MAX_DT) {
+        dt = SPRITE_MAX_DT;
+    }
+    int32_t dt_q16 = (uint64_t)dt * SPRITE_US_TO_Q16 >> 32;
+    uint16_t n = pool->len >> 16;
+
+    for (struct sprite **spp = &pool->active; *spp;) {
+        struct sprite *sp = *spp;
+
+        sp->age += dt_q16;
+        uint32_t c = compose_alpha(sp->color, 0, sprite_alpha(sp));
+        if (!c) {
+            *spp = sp->next;
+            sp->next = pool->free;
+            pool->free = sp;
+            continue;
+        }
+
+        sp->pos += (int64_t)sp->vel * dt_q16 >> 16;
+        while (sp->pos >= pool->len) {
+            sp->pos -= pool->len;
+        }
+        while (sp->pos < 0) {
+            sp->pos += pool->len;
+        }
+
+        uint16_t i = sp->pos >> 16;
+        uint16_t frac = (sp->pos >> 8) & 0xFF;
+        pool->buf[i] = compose_add(pool->buf[i], compose_alpha(c, 0, 256 - frac));
+        if (frac) {
+            if (++i == n) {
+                i = 0;
+            }
+            pool->buf[i] = compose_add(pool->buf[i], compose_alpha(c, 0, frac));
+        }
+
+        spp = &sp->next;
+    }
+}
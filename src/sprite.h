@@ -0,0 +1,80 @@
+#ifndef SUBSPACE_SIGN_SPRITE_H
+#define SUBSPACE_SIGN_SPRITE_H
+
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef SPRITE_MAX
+/**
+ * The number of sprites in a pool. Each costs 24 bytes.
+ */
+#define SPRITE_MAX 32
+#endif
+
+#ifndef SPRITE_MAX_DT
+/**
+ * The longest time step, in µs. After a longer gap, e.g. a doze, sprites carry on as if only this much had passed.
+ */
+#define SPRITE_MAX_DT 1000000
+#endif
+
+/**
+ * Convert LEDs to 16.16 fixed point.
+ */
+#define SPRITE_LEDS(n) ((int32_t)(n) << 16)
+
+/* --- Types --- */
+struct sprite {
+    int32_t pos;    // 16.16 LEDs
+    int32_t vel;    // 16.16 LEDs per second
+    uint32_t color; // 0x00GGRRBB when new
+    uint32_t age;   // 16.16 seconds
+    uint16_t fade;  // 8.8 halvings per second. Zero never fades.
+    struct sprite *next;
+};
+
+/**
+ * A fixed number of sprites moving around a ring of LEDs.
+ */
+struct sprite_pool {
+    uint32_t *buf;
+    int32_t len; // 16.16 LEDs
+    struct sprite sprites[SPRITE_MAX];
+    struct sprite *active;
+    struct sprite *free;
+};
+
+/* --- Functions --- */
+/**
+ * Initialize an empty pool.
+ *
+ * @param pool the pool.
+ * @param buf the buffer to draw into.
+ * @param len the number of LEDs in buf.
+ */
+extern void ICACHE_FLASH_ATTR sprite_pool_init(struct sprite_pool *pool, uint32_t *buf, uint16_t len);
+
+/**
+ * Add a sprite.
+ *
+ * A sprite is removed once it has faded out. It can also be removed by setting its colour to zero.
+ *
+ * @param pool the pool.
+ * @param pos the position, in 16.16 LEDs. Must be in the ring.
+ * @param vel the velocity, in 16.16 LEDs per second. Negative goes backwards.
+ * @param color the colour, as 0x00GGRRBB.
+ * @param fade how fast it fades, in 8.8 halvings per second.
+ * @return the sprite, or NULL if the pool is full.
+ */
+extern struct sprite *ICACHE_FLASH_ATTR sprite_add(struct sprite_pool *pool, int32_t pos, int32_t vel, uint32_t color,
+                                                   uint16_t fade);
+
+/**
+ * Move and fade all sprites by dt, remove those that have faded out, and add the rest to the buffer.
+ *
+ * @param pool the pool.
+ * @param dt the time since the last update, in µs.
+ */
+extern void ICACHE_FLASH_ATTR sprite_update(struct sprite_pool *pool, uint32_t dt);
+
+#endif /* SUBSPACE_SIGN_SPRITE_H */
@@ -5,7 +5,67 @@
 #include <time.h>
 #include <user_interface.h>
 
+#include <cycle-prof.h>
+
 #include "clock.h"
+#include "console.h"
+#include "ddp.h"
+#include "effect.h"
+#include "output.h"
+#include "pipeline.h"
+#include "power.h"
+
+#ifndef FRAME_RATE
+/**
+ * Target frame rate, in Hz. If this is above what the bus can do, frames are sent back to back.
+ */
+#define FRAME_RATE 50
+#endif
+#define FRAME_PERIOD (1000000 / FRAME_RATE) // µs
+#define RENDER_BUDGET (FRAME_PERIOD / 4)    // µs
+
+#ifndef MODE_FADE_FRAMES
+/**
+ * Length of the crossfade when switching modes, in frames.
+ */
+#define MODE_FADE_FRAMES FRAME_RATE
+#endif
+
+#ifndef LED_COUNT
+/**
+ * Number of LEDs in the ring. The driver's MAX_PIXELS must be at least this, e.g. -DWS2811_I2S_MAX_PIXELS=240. So must
+ * CLOCK_MAX_LEDS and EFFECT_MAX_LEDS.
+ */
+#define LED_COUNT 120
+#endif
+
+#define WS2811_NMI_INIT(ctx)                                                                                           \
+    do {                                                                                                               \
+        PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDI_U, FUNC_GPIO12);                                                           \
+        PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, FUNC_GPIO13);                                                           \
+        gpio_init();                                                                                                   \
+        ws2811_init((ctx), 12, 13);                                                                                    \
+    } while (0)
+
+#ifdef WS2811_SECOND_NMI
+/*
+ * Drive a second chain from the GPIO (NMI) driver, next to the primary backend. It mirrors the first one, unless DDP
+ * sends to it, with destination ID 2.
+ */
+#if !defined(WS2811_IMPL_I2S) && !defined(WS2811_IMPL_UART)
+#error "WS2811_SECOND_NMI needs the I2S or UART backend, which don't use GPIO12 or GPIO13"
+#endif
+#include <ws2811-esp8266.h>
+#ifndef WS2811_SECOND_LEN
+/**
+ * Number of LEDs on the second chain.
+ */
+#define WS2811_SECOND_LEN 120
+#endif
+#if WS2811_SECOND_LEN > WS2811_MAX_PIXELS
+#error "WS2811_SECOND_LEN is larger than WS2811_MAX_PIXELS"
+#endif
+#endif
 
 #ifdef WS2811_IMPL_I2S
 #include <pin_mux_register.h>
@@ -16,21 +76,53 @@
         PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDO_U, FUNC_I2SO_BCK);                                                         \
         PIN_FUNC_SELECT(PERIPHS_IO_MUX_U0RXD_U, FUNC_I2SO_DATA);                                                       \
         ws2811_i2s_init((ctx));                                                                                        \
-    \
-} while (0)
-#define WS2811_SEND(ctx, buf, len) ws2811_i2s_send((ctx), (buf), (len))
+    } while (0)
+#if WS2811_I2S_GRADE
+#define WS2811_DEFINE_OPS(name) OUTPUT_DEFINE_GRADED_OPS(name, struct ws2811_i2s_context, ws2811_i2s_)
 #else
-#include <ws2811-esp8266.h>
-#define WS2811_CONTEXT struct ws2811_context
+#define WS2811_DEFINE_OPS(name) OUTPUT_DEFINE_OPS(name, struct ws2811_i2s_context, ws2811_i2s_)
+#endif
+#define WS2811_PRIMARY_PROFILE WS2811_I2S_PROFILE
+#define WS2811_PRIMARY_MAX_PIXELS WS2811_I2S_MAX_PIXELS
+#define WS2811_PRIMARY_GRADES WS2811_I2S_GRADE
+#elif defined(WS2811_IMPL_SPI)
+#include <pin_mux_register.h>
+#include <ws2811-esp8266-spi.h>
+#define WS2811_CONTEXT struct ws2811_spi_context
 #define WS2811_INIT(ctx)                                                                                               \
     do {                                                                                                               \
-        PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDI_U, FUNC_GPIO12);                                                           \
-        PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, FUNC_GPIO13);                                                           \
-        gpio_init();                                                                                                   \
-        ws2811_init((ctx), 12, 13);                                                                                    \
-    \
-} while (0)
-#define WS2811_SEND(ctx, buf, len) ws2811_send((ctx), (buf), (len))
+        PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, FUNC_HSPID_MOSI);                                                       \
+        ws2811_spi_init((ctx));                                                                                        \
+    } while (0)
+#define WS2811_DEFINE_OPS(name) OUTPUT_DEFINE_OPS(name, struct ws2811_spi_context, ws2811_spi_)
+#define WS2811_PRIMARY_PROFILE WS2811_SPI_PROFILE
+#define WS2811_PRIMARY_MAX_PIXELS WS2811_SPI_MAX_PIXELS
+#define WS2811_PRIMARY_GRADES 0
+#elif defined(WS2811_IMPL_UART)
+#include <ws2811-esp8266-uart.h>
+#define WS2811_CONTEXT struct ws2811_uart_context
+#define WS2811_INIT(ctx) ws2811_uart_init((ctx))
+#define WS2811_DEFINE_OPS(name) OUTPUT_DEFINE_OPS(name, struct ws2811_uart_context, ws2811_uart_)
+#define WS2811_PRIMARY_PROFILE WS2811_UART_PROFILE
+#define WS2811_PRIMARY_MAX_PIXELS WS2811_UART_MAX_PIXELS
+#define WS2811_PRIMARY_GRADES 0
+#else
+#include <ws2811-esp8266.h>
+#define WS2811_CONTEXT struct ws2811_context
+#define WS2811_INIT(ctx) WS2811_NMI_INIT(ctx)
+#define WS2811_DEFINE_OPS(name) OUTPUT_DEFINE_OPS(name, struct ws2811_context, ws2811_)
+#define WS2811_PRIMARY_PROFILE WS2811_PROFILE
+#define WS2811_PRIMARY_MAX_PIXELS WS2811_MAX_PIXELS
+#define WS2811_PRIMARY_GRADES 0
+#endif
+#if LED_COUNT > WS2811_PRIMARY_MAX_PIXELS
+#error "LED_COUNT is larger than the driver's MAX_PIXELS"
+#endif
+#if LED_COUNT > CLOCK_MAX_LEDS
+#error "LED_COUNT is larger than CLOCK_MAX_LEDS"
+#endif
+#if LED_COUNT > EFFECT_MAX_LEDS
+#error "LED_COUNT is larger than EFFECT_MAX_LEDS"
 #endif
 
 /* --- Functions --- */
@@ -41,49 +133,301 @@ extern void ets_printf(const char *, ...);
 extern void ets_timer_arm_new(ETSTimer *, int, int, int);
 extern void ets_timer_disarm(ETSTimer *);
 extern void ets_timer_setfn(ETSTimer *, ETSTimerFunc, void *);
-extern void uartAttach(void);
 extern void uart_div_modify(int, int);
-extern int UartGetCmdLn(char *buf);
 
 /* --- Data --- */
-// 0x00GGRRBB
-static uint32_t led_buf[120];
-static const uint8_t LED_BUF_SIZE = sizeof(led_buf) / sizeof(*led_buf);
 static WS2811_CONTEXT ws2811;
-static os_timer_t send_tmr;
-static void (*update_leds)(void);
+WS2811_DEFINE_OPS(ws2811_ops);
+#if !WS2811_PRIMARY_GRADES
+static uint8_t ws2811_residual[LED_COUNT * WS2811_GRADE_CHANNELS];
+static uint32_t ws2811_render[LED_COUNT];
+#endif
+#ifdef WS2811_SECOND_NMI
+static struct ws2811_context ws2811_second;
+OUTPUT_DEFINE_OPS(ws2811_second_ops, struct ws2811_context, ws2811_);
+static uint8_t ws2811_second_residual[WS2811_SECOND_LEN * WS2811_GRADE_CHANNELS];
+static uint32_t ws2811_second_render[WS2811_SECOND_LEN];
+#endif
+// Gamma, brightness and dithering, shared by all outputs.
+static struct ws2811_grade grade;
+// 0x00GGRRBB. This is the first output's buffer, before grading.
+static uint32_t *led_buf;
+static const uint16_t LED_BUF_SIZE = LED_COUNT;
+static os_timer_t frame_tmr;
+static uint32_t next_frame_time; // system_get_time
+static uint32_t late_frames;     // Frames skipped because rendering fell more than a frame behind
+#if CYCLE_PROF
+static struct cycle_prof render_prof;
+#endif
+static bool mode_locked; // Set by the mode command, to stop automatic switching
+static bool streaming;   // Whether the first output's frames were coming from DDP at the last render
 static os_timer_t mode_tmr;
 static struct clock_context clockctx;
 
-static inline void ICACHE_FLASH_ATTR update_running_light(void) {
-    static uint32_t i = 0;
-    uint32_t pos = i % LED_BUF_SIZE;
-    led_buf[pos] = 0;
-    ++i;
-    pos = i % LED_BUF_SIZE;
-    led_buf[pos] = 0x7F7F7F;
+struct running_light {
+    uint16_t pos;
+};
+
+static void ICACHE_FLASH_ATTR running_light_render(void *state, uint32_t *buf, uint16_t len) {
+    struct running_light *rl = (struct running_light *)state;
+    os_memset(buf, 0, len * sizeof(*buf));
+    buf[rl->pos] = 0x7F7F7F;
+    if (++rl->pos == len) {
+        rl->pos = 0;
+    }
 }
 
-static inline void ICACHE_FLASH_ATTR update_clock(void) { clock_update(&clockctx); }
+/**
+ * The clock keeps time whichever mode is shown, so its state stays in clockctx.
+ */
+static void ICACHE_FLASH_ATTR clock_render(void *state, uint32_t *buf, uint16_t len) {
+    if (!clock_is_valid(&clockctx)) {
+        os_memset(buf, 0, len * sizeof(*buf));
+        return;
+    }
+    clockctx.led_buf = buf;
+    clock_update(&clockctx);
+}
+
+// Costs are estimated cycles per LED. Compare them with the render profile in stats.
+static const struct effect running_light_effect = {"running", sizeof(struct running_light), 8, NULL,
+                                                   running_light_render, NULL};
+static const struct effect clock_effect = {"clock", 0, 80, NULL, clock_render, NULL};
+
+/**
+ * Called from a driver interrupt handler, or the GPIO driver's timer, when every output has sent its frame.
+ *
+ * Must be in IRAM.
+ */
+static void frame_done(void *arg) { pipeline_post(PIPELINE_RENDER); }
+
+static void ICACHE_FLASH_ATTR frame_timeout(void *arg) { pipeline_post(PIPELINE_RENDER); }
+
+/**
+ * Called from the UART interrupt handler when console input is available.
+ *
+ * Must be in IRAM.
+ */
+static void console_rx(void *arg) { pipeline_post(PIPELINE_INPUT); }
 
-static void ICACHE_FLASH_ATTR send_timeout(void *arg) {
-    WS2811_CONTEXT *ctx = (WS2811_CONTEXT *)arg;
+static void ICACHE_FLASH_ATTR process_input(void *arg) { console_process(); }
 
-    update_leds();
-    WS2811_SEND(ctx, led_buf, LED_BUF_SIZE);
+/**
+ * Called when a DDP frame has been written into an output's buffer.
+ */
+static void ICACHE_FLASH_ATTR ddp_frame(void *arg) { pipeline_post(PIPELINE_TRANSMIT); }
 
-    char cmdline[128];
-    if (!UartGetCmdLn(cmdline) && cmdline[0] == 'q') {
-        ets_printf("%s", cmdline);
-        system_restart();
+static void ICACHE_FLASH_ATTR render_frame(void *arg) {
+    uint32_t now = system_get_time();
+    int32_t wait = next_frame_time - now;
+    if (wait > 0) {
+        // The bus is faster than FRAME_RATE.
+        os_timer_disarm(&frame_tmr);
+        os_timer_arm(&frame_tmr, (wait + 999) / 1000, 0 /* autoload */);
+        return;
+    }
+    next_frame_time += FRAME_PERIOD;
+    if (wait < -FRAME_PERIOD) {
+        // We're more than a frame late. Don't try to catch up.
+        next_frame_time = now + FRAME_PERIOD;
+        late_frames += -wait / FRAME_PERIOD;
+    }
+
+    if (ddp_is_streaming_to(0)) {
+        // DDP commits its own frames. Keep checking for the stream to time out.
+        os_timer_disarm(&frame_tmr);
+        os_timer_arm(&frame_tmr, FRAME_PERIOD / 1000, 0 /* autoload */);
+        streaming = true;
+        return;
+    }
+    if (streaming) {
+        streaming = false;
+        if (!mode_locked) {
+            effect_switch(&clock_effect, 0);
+        }
+    }
+
+    CYCLE_PROF_START(prof_start);
+    effect_render();
+    CYCLE_PROF_END(&render_prof, prof_start);
+    pipeline_post(PIPELINE_TRANSMIT);
+}
+
+/**
+ * Copy the first output to the others, as far as they are long enough, unless DDP is driving them.
+ */
+static void ICACHE_FLASH_ATTR mirror_outputs(void) {
+    for (uint8_t i = 1; i < output_count(); ++i) {
+        if (ddp_is_streaming_to(i)) {
+            continue;
+        }
+        struct output *out = output_get(i);
+        uint16_t len = out->len < LED_BUF_SIZE ? out->len : LED_BUF_SIZE;
+        os_memcpy(out->buf, led_buf, len * sizeof(*led_buf));
+    }
+}
+
+static void ICACHE_FLASH_ATTR transmit_frame(void *arg) {
+    mirror_outputs();
+    bool sent = output_commit_all() > 0;
+    // Light sleep would hold up packets until the next beacon.
+    power_frame(sent || ddp_is_streaming(), &next_frame_time);
+    if (!sent) {
+        // Nothing changed, so no frame-done will come. render_frame waits for the next frame time.
+        pipeline_post(PIPELINE_RENDER);
+    }
+}
+
+static void ICACHE_FLASH_ATTR print_pipeline_stats(bool all) {
+    static const char *const NAMES[PIPELINE_NUM_STAGES] = {"input", "render", "transmit"};
+    static uint32_t prev_overruns[PIPELINE_NUM_STAGES];
+
+    for (int i = 0; i < PIPELINE_NUM_STAGES; ++i) {
+        const struct pipeline_stage_stats *stats = pipeline_stats(i);
+        if (all || stats->overruns != prev_overruns[i]) {
+            ets_printf("pipeline: %s overran %u of %u times, max %u us\n", NAMES[i], stats->overruns, stats->runs,
+                       stats->max_time);
+            prev_overruns[i] = stats->overruns;
+        }
     }
 }
 
 static void ICACHE_FLASH_ATTR mode_timeout(void *arg) {
-    if (update_leds == update_running_light && clock_is_valid(&clockctx)) {
-        update_leds = update_clock;
+    if (!mode_locked && effect_current() == &running_light_effect && clock_is_valid(&clockctx)) {
+        effect_switch(&clock_effect, MODE_FADE_FRAMES);
+    }
+
+    print_pipeline_stats(false);
+
+    static uint32_t prev_superseded_frames;
+    uint32_t superseded_frames = output_superseded_frames();
+    if (superseded_frames != prev_superseded_frames) {
+        ets_printf("ws2811: %u frames superseded\n", superseded_frames);
+        prev_superseded_frames = superseded_frames;
+    }
+}
+static void ICACHE_FLASH_ATTR cmd_restart(int argc, char **argv) { system_restart(); }
+
+static void ICACHE_FLASH_ATTR cmd_mode(int argc, char **argv) {
+    if (argc > 1) {
+        bool is_auto = !os_strcmp(argv[1], "auto");
+        const struct effect *effect = is_auto ? &running_light_effect : effect_find(argv[1]);
+        if (!effect) {
+            ets_printf("usage: mode [");
+            for (uint8_t i = 0; i < effect_count(); ++i) {
+                ets_printf("%s|", effect_get(i)->name);
+            }
+            ets_printf("auto]\n");
+            return;
+        }
+        if (!effect_fits(effect_current(), effect)) {
+            ets_printf("mode: %s and %s don't fit the render budget together, cutting\n", effect_current()->name,
+                       effect->name);
+        }
+        if (!effect_switch(effect, MODE_FADE_FRAMES)) {
+            ets_printf("mode: failed to start %s\n", effect->name);
+            return;
+        }
+        mode_locked = !is_auto;
     }
+
+    ets_printf("mode: %s%s\n", effect_current()->name, mode_locked ? "" : " (auto)");
+}
+
+static void ICACHE_FLASH_ATTR cmd_brightness(int argc, char **argv) {
+    if (argc > 1) {
+        int v = atoi(argv[1]);
+        if (v < 0 || v > 255) {
+            ets_printf("usage: brightness [0-255]\n");
+            return;
+        }
+        ws2811_grade_set_brightness(&grade, v);
+        // The frame may not change, but it should look different.
+        output_invalidate();
+    }
+
+    ets_printf("brightness: %d\n", grade.brightness);
 }
+
+static void ICACHE_FLASH_ATTR cmd_tz(int argc, char **argv) {
+    if (argc > 1 && !clock_set_tz(&clockctx, argv[1])) {
+        ets_printf("usage: tz [POSIX TZ string, e.g. CET-1CEST,M3.5.0,M10.5.0/3]\n");
+        return;
+    }
+
+    const char *name = clock_tz_name(&clockctx);
+    ets_printf("tz: %s\n", name ? name : "(no time yet)");
+}
+
+static void ICACHE_FLASH_ATTR cmd_stats(int argc, char **argv) {
+    if (argc > 1) {
+        if (os_strcmp(argv[1], "reset")) {
+            ets_printf("usage: stats [reset]\n");
+            return;
+        }
+        late_frames = 0;
+#if CYCLE_PROF
+        cycle_prof_reset(&render_prof);
+#endif
+#if WS2811_PRIMARY_PROFILE
+        os_memset(&ws2811.prof, 0, sizeof(ws2811.prof));
+#endif
+#if defined(WS2811_SECOND_NMI) && WS2811_PROFILE
+        os_memset(&ws2811_second.prof, 0, sizeof(ws2811_second.prof));
+#endif
+        for (int i = 0; i < PIPELINE_NUM_STAGES; ++i) {
+            os_memset(pipeline_stats(i), 0, sizeof(struct pipeline_stage_stats));
+        }
+        for (uint8_t i = 0; i < output_count(); ++i) {
+            output_get(i)->skipped_frames = 0;
+        }
+        os_memset(power_stats(), 0, sizeof(struct power_stats));
+        os_memset(ddp_stats(), 0, sizeof(struct ddp_stats));
+        return;
+    }
+
+    print_pipeline_stats(true);
+    ets_printf("render: %u frames late\n", late_frames);
+    for (uint8_t i = 0; i < output_count(); ++i) {
+        struct output *out = output_get(i);
+        ets_printf("%s: %u frames superseded, %u unchanged frames skipped\n", out->name,
+                   out->ops->superseded_frames(out->ctx), out->skipped_frames);
+    }
+    ets_printf("power: dozed %u times, %u ms\n", power_stats()->dozes, power_stats()->doze_time);
+    ets_printf("ddp: %u packets, %u frames, %u bad, %u out of order%s\n", ddp_stats()->packets, ddp_stats()->frames,
+               ddp_stats()->bad_packets, ddp_stats()->out_of_order, ddp_is_streaming() ? ", streaming" : "");
+    ets_printf("console: %u bytes dropped\n", console_dropped());
+    ets_printf("heap: %u bytes free\n", system_get_free_heap_size());
+#if CYCLE_PROF
+    cycle_prof_print("render", &render_prof);
+#endif
+#if WS2811_PRIMARY_PROFILE
+    cycle_prof_print("ws2811 encode", &ws2811.prof.encode);
+    cycle_prof_print("ws2811 isr", &ws2811.prof.isr);
+#endif
+#if defined(WS2811_SECOND_NMI) && WS2811_PROFILE
+    cycle_prof_print("ws2811_second encode", &ws2811_second.prof.encode);
+    cycle_prof_print("ws2811_second isr", &ws2811_second.prof.isr);
+#endif
+#if defined(WS2811_IMPL_I2S) && WS2811_I2S_PROFILE
+    ets_printf("ws2811: %u FIFO underruns\n", ws2811.prof.underruns);
+    if (ws2811.prof.frames) {
+        ets_printf("ws2811: %u frames, %u avg / %u max ISRs per frame\n", ws2811.prof.frames,
+                   ws2811.prof.isr.count / ws2811.prof.frames, ws2811.prof.max_frame_isrs);
+    }
+#endif
+}
+
+static const struct console_command COMMANDS[] = {
+    {"mode", "show or set the display mode: running, clock or auto", cmd_mode},
+    {"brightness", "show or set the brightness, 0-255", cmd_brightness},
+    {"tz", "show the time zone, or set it from a POSIX TZ string", cmd_tz},
+    {"stats", "print pipeline, driver and profiling statistics, or reset them", cmd_stats},
+    {"restart", "restart the device", cmd_restart},
+    {"q", "alias for restart", cmd_restart},
+    {NULL},
+};
+
 static void ICACHE_FLASH_ATTR scan_done(void *arg, STATUS status) {
     if (status != OK) {
         ets_printf("scan failed: %d\n", status);
@@ -118,10 +462,32 @@ static void ICACHE_FLASH_ATTR start_wifi_scan(void) {
 }
 
 static void ICACHE_FLASH_ATTR inited(void) {
-    os_timer_setfn(&send_tmr, send_timeout, &ws2811);
     // If TxH+TxL = 1.2 µs, then 120 LEDs take 1.2 * 24 * 120 = 3.5 ms.
-    // So that's a minimum bound.
-    os_timer_arm(&send_tmr, 20 /* ms */, 1 /* autoload */);
+    // So that's a minimum bound on FRAME_PERIOD. Each finished frame triggers rendering of the next.
+    static const struct pipeline_stage_config stages[PIPELINE_NUM_STAGES] = {
+        [PIPELINE_INPUT] = {process_input, NULL, 1000 /* µs */},
+        [PIPELINE_RENDER] = {render_frame, NULL, RENDER_BUDGET},
+        [PIPELINE_TRANSMIT] = {transmit_frame, NULL, 1000 /* µs */},
+    };
+    if (!pipeline_init(stages)) {
+        ets_printf("Failed pipeline_init\n");
+        return;
+    }
+    power_init();
+    os_timer_setfn(&frame_tmr, frame_timeout, NULL);
+    output_set_frame_done_cb(frame_done, NULL);
+    next_frame_time = system_get_time();
+    pipeline_post(PIPELINE_RENDER);
+
+    if (!ddp_init(ddp_frame, NULL)) {
+        ets_printf("Failed ddp_init\n");
+    }
+
+    console_init(COMMANDS, console_rx, NULL);
+#ifdef WS2811_IMPL_UART
+    // The console took over the UART interrupt.
+    console_set_uart1_intr(ws2811_uart_intr, &ws2811);
+#endif
 
     os_timer_setfn(&mode_tmr, mode_timeout, NULL);
     os_timer_arm(&mode_tmr, 1000 /* ms */, 1 /* autoload */);
@@ -143,22 +509,42 @@ static void ICACHE_FLASH_ATTR handle_wifi_event(System_Event_t *event) {
 }
 
 void ICACHE_FLASH_ATTR user_init() {
-    uartAttach();
     uart_div_modify(0, UART_CLK_FREQ / 115200);
-    ETS_UART_INTR_ENABLE();
 
     wifi_station_set_auto_connect(false);
     wifi_set_opmode(STATION_MODE);
     wifi_set_event_handler_cb(handle_wifi_event);
 
     WS2811_INIT(&ws2811);
-    os_memset(led_buf, 0, sizeof(led_buf));
-    update_leds = update_running_light;
+#ifdef WS2811_IMPL_I2S
+    ets_printf("ws2811_i2s: %d bytes of encoder tables in RAM\n", WS2811_I2S_LUT_RAM_SIZE);
+#endif
+    ws2811_grade_init(&grade, 255);
+    struct output *out = output_add("ws2811", &ws2811_ops, &ws2811, LED_BUF_SIZE);
+#if WS2811_PRIMARY_GRADES
+    output_set_grade(out, &grade, NULL, NULL);
+#else
+    output_set_grade(out, &grade, ws2811_residual, ws2811_render);
+#endif
+    led_buf = out->buf;
+#ifdef WS2811_SECOND_NMI
+    WS2811_NMI_INIT(&ws2811_second);
+    out = output_add("ws2811_second", &ws2811_second_ops, &ws2811_second, WS2811_SECOND_LEN);
+    output_set_grade(out, &grade, ws2811_second_residual, ws2811_second_render);
+#endif
 
     if (!clock_init(&clockctx, led_buf, LED_BUF_SIZE)) {
         ets_printf("Failed clock_init\n");
         return;
     }
 
+    if (!effect_init(led_buf, LED_BUF_SIZE, RENDER_BUDGET * system_get_cpu_freq())) {
+        ets_printf("Failed effect_init\n");
+        return;
+    }
+    effect_register(&running_light_effect);
+    effect_register(&clock_effect);
+    effect_switch(&running_light_effect, 0);
+
     system_init_done_cb(inited);
 }
@@ -0,0 +1,277 @@
+/**
+ * POSIX TZ strings, as in the TZ environment variable.
+ *
+ * The two transitions of a year are computed when a time in a new year is first seen, and cached, so converting is
+ * normally a comparison and an addition. Years are UTC years; no real rule has a transition close enough to New Year
+ * for that to matter.
+ */
+#include <osapi.h>
+
+#include "tz.h"
+
+/* --- Macros --- */
+#define TZ_DAY 86400    // s
+#define TZ_HOUR 3600    // s
+#define TZ_DEFAULT_TIME (2 * TZ_HOUR)
+#define TZ_EPOCH_WDAY 4 // 1970-01-01 was a Thursday
+
+/* --- Functions --- */
+static bool ICACHE_FLASH_ATTR tz_is_leap(int32_t y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+
+/**
+ * Return the number of days from 1970-01-01 to the given date. From Howard Hinnant's date algorithms.
+ */
+static int32_t ICACHE_FLASH_ATTR tz_days_from_civil(int32_t y, uint8_t m, uint8_t d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/**
+ * Return the year of the given number of days since 1970-01-01. The inverse of tz_days_from_civil.
+ */
+static int32_t ICACHE_FLASH_ATTR tz_year_from_days(int32_t z) {
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int32_t doe = z - era * 146097;
+    int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int32_t mp = (5 * doy + 2) / 153;
+    return yoe + era * 400 + (mp >= 10);
+}
+
+/**
+ * Return the number of days from 1970-01-01 to the day a rule falls on in year y.
+ */
+static int32_t ICACHE_FLASH_ATTR tz_rule_day(const struct tz_rule *rule, int32_t y) {
+    static const uint8_t MDAYS[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    switch (rule->type) {
+    case TZ_RULE_JULIAN:
+        return tz_days_from_civil(y, 1, 1) + rule->day - 1 + (tz_is_leap(y) && rule->day >= 60);
+
+    case TZ_RULE_DAY:
+        return tz_days_from_civil(y, 1, 1) + rule->day;
+
+    default: {
+        int32_t first = tz_days_from_civil(y, rule->month, 1);
+        uint8_t first_wday = (first % 7 + 7 + TZ_EPOCH_WDAY) % 7;
+        uint8_t mdays = MDAYS[rule->month - 1] + (rule->month == 2 && tz_is_leap(y));
+        uint8_t mday = (rule->wday + 7 - first_wday) % 7 + 1 + (rule->week - 1) * 7;
+        if (mday > mdays) {
+            // Week 5 means the last one.
+            mday -= 7;
+        }
+        return first + mday - 1;
+    }
+    }
+}
+
+/**
+ * Compute the transitions of the year t is in.
+ */
+static void ICACHE_FLASH_ATTR tz_cache_year(struct tz *tz, time_t t) {
+    int32_t days = t / TZ_DAY - (t % TZ_DAY < 0);
+    int32_t y = tz_year_from_days(days);
+
+    tz->year_begin = (time_t)tz_days_from_civil(y, 1, 1) * TZ_DAY;
+    tz->year_end = (time_t)tz_days_from_civil(y + 1, 1, 1) * TZ_DAY;
+    // Each rule is in the local time in effect before it.
+    tz->dst_begin = (time_t)tz_rule_day(&tz->start, y) * TZ_DAY + tz->start.time - tz->std_offset;
+    tz->dst_end = (time_t)tz_rule_day(&tz->end, y) * TZ_DAY + tz->end.time - tz->dst_offset;
+}
+
+static bool ICACHE_FLASH_ATTR tz_is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static bool ICACHE_FLASH_ATTR tz_is_alpha(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'); }
+
+/**
+ * Parse an unsigned number of at most max.
+ *
+ * @return the position after the number, or NULL.
+ */
+static const char *ICACHE_FLASH_ATTR tz_parse_num(const char *s, int32_t max, int32_t *v) {
+    if (!tz_is_digit(*s)) {
+        return NULL;
+    }
+    for (*v = 0; tz_is_digit(*s); ++s) {
+        *v = *v * 10 + (*s - '0');
+        if (*v > max) {
+            return NULL;
+        }
+    }
+    return s;
+}
+
+/**
+ * Parse [+-]hh[:mm[:ss]] into seconds.
+ */
+static const char *ICACHE_FLASH_ATTR tz_parse_time(const char *s, int32_t max_hours, int32_t *secs) {
+    int32_t sign = 1;
+    if (*s == '+' || *s == '-') {
+        sign = (*s++ == '-' ? -1 : 1);
+    }
+
+    int32_t v;
+    if (!(s = tz_parse_num(s, max_hours, &v))) {
+        return NULL;
+    }
+    *secs = v * TZ_HOUR;
+    for (int32_t unit = 60; *s == ':' && unit; unit /= 60) {
+        if (!(s = tz_parse_num(s + 1, 59, &v))) {
+            return NULL;
+        }
+        *secs += v * unit;
+    }
+    *secs *= sign;
+    return s;
+}
+
+/**
+ * Parse a zone abbreviation, either alphabetic or quoted in <>.
+ */
+static const char *ICACHE_FLASH_ATTR tz_parse_name(const char *s, char *name) {
+    uint8_t n = 0;
+    if (*s == '<') {
+        for (++s; *s && *s != '>'; ++s, ++n) {
+            if (n < TZ_NAME_LEN - 1) {
+                name[n] = *s;
+            }
+        }
+        if (*s++ != '>') {
+            return NULL;
+        }
+    } else {
+        for (; tz_is_alpha(*s); ++s, ++n) {
+            if (n < TZ_NAME_LEN - 1) {
+                name[n] = *s;
+            }
+        }
+    }
+    if (n < 3) {
+        return NULL;
+    }
+    name[n < TZ_NAME_LEN - 1 ? n : TZ_NAME_LEN - 1] = '\0';
+    return s;
+}
+
+/**
+ * Parse a rule: Jn, n or Mm.w.d, and an optional /time.
+ */
+static const char *ICACHE_FLASH_ATTR tz_parse_rule(const char *s, struct tz_rule *rule) {
+    int32_t v;
+
+    if (*s == 'M') {
+        rule->type = TZ_RULE_MONTH;
+        if (!(s = tz_parse_num(s + 1, 12, &v)) || !v || *s != '.') {
+            return NULL;
+        }
+        rule->month = v;
+        if (!(s = tz_parse_num(s + 1, 5, &v)) || !v || *s != '.') {
+            return NULL;
+        }
+        rule->week = v;
+        if (!(s = tz_parse_num(s + 1, 6, &v))) {
+            return NULL;
+        }
+        rule->wday = v;
+    } else if (*s == 'J') {
+        rule->type = TZ_RULE_JULIAN;
+        if (!(s = tz_parse_num(s + 1, 365, &v)) || !v) {
+            return NULL;
+        }
+        rule->day = v;
+    } else {
+        rule->type = TZ_RULE_DAY;
+        if (!(s = tz_parse_num(s, 365, &v))) {
+            return NULL;
+        }
+        rule->day = v;
+    }
+
+    rule->time = TZ_DEFAULT_TIME;
+    if (*s == '/') {
+        // POSIX says 0-24, but later extensions allow -167 to 167.
+        s = tz_parse_time(s + 1, 167, &rule->time);
+    }
+    return s;
+}
+
+bool ICACHE_FLASH_ATTR tz_parse(struct tz *tz, const char *s) {
+    struct tz z;
+    os_memset(&z, 0, sizeof(z));
+
+    if (!(s = tz_parse_name(s, z.std_name)) || !(s = tz_parse_time(s, 24, &z.std_offset))) {
+        return false;
+    }
+    // POSIX offsets are west of UTC.
+    z.std_offset = -z.std_offset;
+    z.dst_offset = z.std_offset;
+
+    if (*s) {
+        if (!(s = tz_parse_name(s, z.dst_name))) {
+            return false;
+        }
+        z.has_dst = true;
+        z.dst_offset = z.std_offset + TZ_HOUR;
+        if (*s && *s != ',') {
+            if (!(s = tz_parse_time(s, 24, &z.dst_offset))) {
+                return false;
+            }
+            z.dst_offset = -z.dst_offset;
+        }
+
+        if (!*s) {
+            s = ",M3.2.0,M11.1.0";
+        }
+        if (*s != ',' || !(s = tz_parse_rule(s + 1, &z.start)) || *s != ',' || !(s = tz_parse_rule(s + 1, &z.end))) {
+            return false;
+        }
+        if (*s) {
+            return false;
+        }
+    }
+
+    // Make sure the cache is filled on first use.
+    z.year_begin = 1;
+    z.year_end = 0;
+    *tz = z;
+    return true;
+}
+
+int32_t ICACHE_FLASH_ATTR tz_offset(struct tz *tz, time_t t, bool *isdst) {
+    bool dst = false;
+
+    if (tz->has_dst) {
+        if (t < tz->year_begin || t >= tz->year_end) {
+            tz_cache_year(tz, t);
+        }
+        if (tz->dst_begin < tz->dst_end) {
+            dst = t >= tz->dst_begin && t < tz->dst_end;
+        } else {
+            // Southern hemisphere.
+            dst = t >= tz->dst_begin || t < tz->dst_end;
+        }
+    }
+
+    if (isdst) {
+        *isdst = dst;
+    }
+    return dst ? tz->dst_offset : tz->std_offset;
+}
+
+void ICACHE_FLASH_ATTR tz_localtime_r(struct tz *tz, const time_t *t, struct tm *tm) {
+    bool isdst;
+    time_t local = *t + tz_offset(tz, *t, &isdst);
+    gmtime_r(&local, tm);
+    tm->tm_isdst = isdst;
+}
+
+const char *ICACHE_FLASH_ATTR tz_name(struct tz *tz, time_t t) {
+    bool isdst;
+    tz_offset(tz, t, &isdst);
+    return isdst ? tz->dst_name : tz->std_name;
+}
@@ -0,0 +1,87 @@
+#ifndef SUBSPACE_SIGN_TZ_H
+#define SUBSPACE_SIGN_TZ_H
+
+#include <time.h>
+#include <user_interface.h>
+
+/* --- Macros --- */
+#ifndef TZ_NAME_LEN
+/**
+ * Maximum length of a zone abbreviation, including the terminating NUL. Longer ones are truncated.
+ */
+#define TZ_NAME_LEN 8
+#endif
+
+/* --- Types --- */
+enum tz_rule_type {
+    TZ_RULE_MONTH,  // Mm.w.d: day d (0 = Sunday) of week w (5 = last) of month m
+    TZ_RULE_JULIAN, // Jn: day n (1-365), not counting 29 February
+    TZ_RULE_DAY,    // n: day n (0-365), counting 29 February
+};
+
+/**
+ * When a transition happens, in local time before the transition.
+ */
+struct tz_rule {
+    enum tz_rule_type type;
+    uint8_t month; // 1-12
+    uint8_t week;  // 1-5
+    uint8_t wday;  // 0-6
+    uint16_t day;
+    int32_t time; // Seconds after midnight
+};
+
+struct tz {
+    char std_name[TZ_NAME_LEN];
+    char dst_name[TZ_NAME_LEN];
+    int32_t std_offset; // Seconds east of UTC
+    int32_t dst_offset; // Seconds east of UTC
+    bool has_dst;
+    struct tz_rule start; // Into DST
+    struct tz_rule end;   // Out of DST
+
+    // The transitions of the cached year, as UTC.
+    time_t year_begin;
+    time_t year_end;
+    time_t dst_begin;
+    time_t dst_end;
+};
+
+/* --- Functions --- */
+/**
+ * Parse a POSIX TZ string, e.g. "GMT0IST,M3.5.0/1,M10.5.0".
+ *
+ * If there is a DST name but no rules, the current US rules "M3.2.0,M11.1.0" are used.
+ *
+ * @param tz the zone to fill in. Left untouched on failure.
+ * @param s the TZ string.
+ * @return true on success.
+ */
+extern bool ICACHE_FLASH_ATTR tz_parse(struct tz *tz, const char *s);
+
+/**
+ * Return the offset from UTC at t, in seconds east.
+ *
+ * The transitions are computed once per year, so this is normally a couple of comparisons.
+ *
+ * @param tz the zone.
+ * @param t the UTC time.
+ * @param isdst set to whether DST is in effect. May be NULL.
+ */
+extern int32_t ICACHE_FLASH_ATTR tz_offset(struct tz *tz, time_t t, bool *isdst);
+
+/**
+ * Convert t to local time, like localtime_r.
+ *
+ * @param tz the zone.
+ * @param t the UTC time.
+ * @param tm the result.
+ */
+extern void ICACHE_FLASH_ATTR tz_localtime_r(struct tz *tz, const time_t *t, struct tm *tm);
+
+/**
+ * Return the abbreviation in effect at t.
+ */
+extern const char *ICACHE_FLASH_ATTR tz_name(struct tz *tz, time_t t);
+
+#endif /* SUBSPACE_SIGN_TZ_H */
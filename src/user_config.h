@@ -1 +1,4 @@
 #define WS2811_IMPL_I2S
+// Also drive a second chain from the GPIO driver on GPIO13. It shows what the first one does, unless DDP sends to it
+// with destination ID 2.
+// #define WS2811_SECOND_NMI
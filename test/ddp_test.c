@@ -0,0 +1,365 @@
+/**
+ * Test the DDP receiver: pixel decoding at every offset and length, sequence numbers, frame completion, malformed
+ * packets, destination IDs and the stream timeout.
+ *
+ * The receiver is included, so its static helpers can be tested directly. Packets are fed through the receive callback
+ * it registers with the espconn stand-in, with a settable clock and two outputs of different lengths.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "ddp.c"
+
+/* --- Macros --- */
+#define TEST_LEDS 5
+#define TEST_SECOND_LEDS 3
+#define TEST_GUARD 2          // Pixels after the buffer that must never be written
+#define TEST_FILL 0x00A5A5A5u // Buffer contents before each write. The top byte is always zero.
+#define TEST_MAX_PACKET 64
+#define TEST_CHECK_PERIOD 20000 // µs between ddp_is_streaming calls, as from the main loop at 50 Hz
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond);                                                     \
+            ++failures;                                                                                                \
+        }                                                                                                              \
+    } while (0)
+
+/* --- Data --- */
+static int failures;
+static uint32_t fake_time;
+static struct espconn *registered_conn;
+static espconn_recv_callback registered_cb;
+static uint32_t test_buf[TEST_LEDS + TEST_GUARD];
+static uint32_t second_buf[TEST_SECOND_LEDS + TEST_GUARD];
+static struct output test_outputs[2];
+static uint32_t frames_seen;
+
+/* --- Functions --- */
+uint32 system_get_time(void) { return fake_time; }
+
+sint8 espconn_create(struct espconn *espconn) {
+    registered_conn = espconn;
+    return 0;
+}
+
+sint8 espconn_regist_recvcb(struct espconn *espconn, espconn_recv_callback recv_cb) {
+    (void)espconn;
+    registered_cb = recv_cb;
+    return 0;
+}
+
+uint8_t output_count(void) { return 2; }
+
+struct output *output_get(uint8_t i) { return &test_outputs[i]; }
+
+static void count_frame(void *arg) {
+    (void)arg;
+    ++frames_seen;
+}
+
+static void start(void) {
+    for (size_t i = 0; i < TEST_LEDS + TEST_GUARD; ++i) {
+        test_buf[i] = TEST_FILL;
+    }
+    for (size_t i = 0; i < TEST_SECOND_LEDS + TEST_GUARD; ++i) {
+        second_buf[i] = TEST_FILL;
+    }
+    test_outputs[0].buf = test_buf;
+    test_outputs[0].len = TEST_LEDS;
+    test_outputs[1].buf = second_buf;
+    test_outputs[1].len = TEST_SECOND_LEDS;
+    fake_time = 1000000;
+    frames_seen = 0;
+    ddp_init(count_frame, NULL);
+}
+
+/**
+ * Send a packet with the given header fields and RGB bytes 1, 2, 3, ... through the receive callback.
+ */
+static void send(uint8_t flags, uint8_t seq, uint8_t type, uint8_t id, uint32_t offset, uint16_t n) {
+    uint8_t p[TEST_MAX_PACKET];
+    uint8_t header_len = DDP_HEADER_LEN + (flags & DDP_FLAG_TIMECODE ? DDP_TIMECODE_LEN : 0);
+    memset(p, 0, header_len);
+    p[0] = DDP_VERSION_1 | flags;
+    p[1] = seq;
+    p[2] = type;
+    p[3] = id;
+    p[4] = offset >> 24;
+    p[5] = offset >> 16;
+    p[6] = offset >> 8;
+    p[7] = offset;
+    p[8] = n >> 8;
+    p[9] = n;
+    for (uint16_t i = 0; i < n; ++i) {
+        p[header_len + i] = i + 1;
+    }
+    registered_cb(registered_conn, (char *)p, header_len + n);
+}
+
+static void send_rgb(uint8_t flags, uint8_t seq, uint32_t offset, uint16_t n) {
+    send(flags, seq, DDP_TYPE_RGB8, DDP_ID_DISPLAY, offset, n);
+}
+
+static void test_init(void) {
+    start();
+    CHECK(registered_cb != NULL);
+    CHECK(registered_conn && registered_conn->type == ESPCONN_UDP);
+    CHECK(registered_conn && registered_conn->proto.udp->local_port == DDP_PORT);
+    CHECK(!ddp_is_streaming());
+}
+
+static void test_channel_order(void) {
+    start();
+    const uint8_t rgb[] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    ddp_write(test_buf, TEST_LEDS, 0, rgb, sizeof(rgb));
+    CHECK(test_buf[0] == 0x00221133);
+    CHECK(test_buf[1] == 0x00554466);
+    CHECK(test_buf[2] == TEST_FILL);
+}
+
+/**
+ * Compare ddp_write at every offset and length, including unaligned ones and ones past the end, with writing one byte
+ * at a time.
+ */
+static void test_write_offsets(void) {
+    uint8_t data[(TEST_LEDS + 2) * 3];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = 0x10 + i;
+    }
+
+    for (uint32_t offset = 0; offset <= TEST_LEDS * 3 + 3; ++offset) {
+        for (uint16_t n = 0; n <= sizeof(data); ++n) {
+            start();
+            uint32_t want[TEST_LEDS + TEST_GUARD];
+            memcpy(want, test_buf, sizeof(want));
+            for (uint32_t i = offset; i < offset + n && i < TEST_LEDS * 3; ++i) {
+                uint8_t shift = DDP_CHANNEL_SHIFTS[i % 3];
+                want[i / 3] = (want[i / 3] & ~(0xFFu << shift)) | ((uint32_t)data[i - offset] << shift);
+            }
+
+            ddp_write(test_buf, TEST_LEDS, offset, data, n);
+            if (memcmp(test_buf, want, sizeof(want))) {
+                printf("FAIL %s: offset %u, %u bytes\n", __func__, offset, n);
+                ++failures;
+            }
+        }
+    }
+}
+
+static void test_seq_ok(void) {
+    start();
+    CHECK(ddp_seq_ok(0));
+    CHECK(ddp_seq_ok(9)); // Nothing seen yet
+
+    ddp_last_seq = 5;
+    CHECK(ddp_seq_ok(0));
+    CHECK(ddp_seq_ok(6));
+    CHECK(ddp_seq_ok(12));  // Seven ahead
+    CHECK(!ddp_seq_ok(13)); // Seven behind
+    CHECK(!ddp_seq_ok(5));
+    CHECK(!ddp_seq_ok(4));
+
+    ddp_last_seq = 15;
+    CHECK(ddp_seq_ok(1)); // Wraps from 15 to 1, skipping 0
+    CHECK(ddp_seq_ok(7));
+    CHECK(!ddp_seq_ok(8));
+    CHECK(!ddp_seq_ok(15));
+    CHECK(!ddp_seq_ok(14));
+
+    ddp_last_seq = 1;
+    CHECK(!ddp_seq_ok(15));
+    CHECK(ddp_seq_ok(2));
+}
+
+static void test_frames(void) {
+    start();
+    send_rgb(0, 1, 0, 6);
+    CHECK(frames_seen == 0);
+    CHECK(test_buf[0] == 0x00020103);
+    CHECK(test_buf[1] == 0x00050406);
+
+    send_rgb(DDP_FLAG_PUSH, 2, 6, 3);
+    CHECK(frames_seen == 1);
+    CHECK(test_buf[2] == 0x00020103);
+
+    // Reaching the end of the buffer completes a frame without a push.
+    send_rgb(0, 3, 9, 6);
+    CHECK(frames_seen == 2);
+    CHECK(test_buf[4] == 0x00050406);
+    CHECK(test_buf[TEST_LEDS] == TEST_FILL);
+
+    // So does running past it, which is clipped.
+    send_rgb(0, 4, 12, 9);
+    CHECK(frames_seen == 3);
+    CHECK(test_buf[TEST_LEDS] == TEST_FILL);
+
+    // A timecode goes between the header and the data.
+    send_rgb(DDP_FLAG_TIMECODE | DDP_FLAG_PUSH, 5, 0, 3);
+    CHECK(frames_seen == 4);
+    CHECK(test_buf[0] == 0x00020103);
+
+    CHECK(ddp_stats()->packets == 5);
+    CHECK(ddp_stats()->frames == 4);
+    CHECK(ddp_stats()->bad_packets == 0);
+    CHECK(ddp_is_streaming());
+}
+
+static void test_bad_packets(void) {
+    start();
+    uint8_t p[DDP_HEADER_LEN] = {DDP_VERSION_1 | DDP_FLAG_PUSH, 1, DDP_TYPE_RGB8, DDP_ID_DISPLAY};
+    registered_cb(registered_conn, (char *)p, DDP_HEADER_LEN - 1);
+    p[0] = 0x80 | DDP_FLAG_PUSH; // Version 2
+    registered_cb(registered_conn, (char *)p, DDP_HEADER_LEN);
+    send_rgb(DDP_FLAG_QUERY, 1, 0, 3);
+    send_rgb(DDP_FLAG_REPLY, 1, 0, 3);
+    send(DDP_FLAG_PUSH, 1, 0x1B, DDP_ID_DISPLAY, 0, 3);              // RGB, 16 bits per channel
+    send(DDP_FLAG_PUSH, 1, DDP_TYPE_RGB8, DDP_ID_DISPLAY + 2, 0, 3); // There are only two outputs
+    CHECK(ddp_stats()->bad_packets == 6);
+
+    // Shorter than its data length.
+    p[0] = DDP_VERSION_1 | DDP_FLAG_PUSH;
+    p[9] = 3;
+    registered_cb(registered_conn, (char *)p, DDP_HEADER_LEN + 2);
+    CHECK(ddp_stats()->bad_packets == 7);
+
+    CHECK(ddp_stats()->packets == 0);
+    CHECK(frames_seen == 0);
+    CHECK(test_buf[0] == TEST_FILL);
+    CHECK(second_buf[0] == TEST_FILL);
+    CHECK(!ddp_is_streaming());
+
+    // Older senders use the legacy type, and some leave it undefined or send to all devices.
+    send(DDP_FLAG_PUSH, 1, DDP_TYPE_RGB_LEGACY, DDP_ID_DISPLAY, 0, 3);
+    send(DDP_FLAG_PUSH, 2, DDP_TYPE_UNDEFINED, DDP_ID_DISPLAY, 0, 3);
+    send(DDP_FLAG_PUSH, 3, DDP_TYPE_RGB8, DDP_ID_ALL, 0, 3);
+    CHECK(ddp_stats()->packets == 3);
+    CHECK(frames_seen == 3);
+}
+
+static void test_out_of_order(void) {
+    start();
+    send_rgb(0, 14, 0, 3);
+    send_rgb(0, 15, 3, 3);
+    send_rgb(0, 1, 6, 3);
+    CHECK(ddp_stats()->packets == 3);
+
+    // A late packet from before the wrap doesn't overwrite newer pixels.
+    test_buf[0] = 0;
+    send_rgb(DDP_FLAG_PUSH, 15, 0, 3);
+    CHECK(ddp_stats()->out_of_order == 1);
+    CHECK(test_buf[0] == 0);
+    CHECK(frames_seen == 0);
+
+    // Nor does a repeat.
+    send_rgb(DDP_FLAG_PUSH, 1, 0, 3);
+    CHECK(ddp_stats()->out_of_order == 2);
+    CHECK(test_buf[0] == 0);
+
+    // Senders that don't number their packets are never out of order.
+    send_rgb(DDP_FLAG_PUSH, 0, 0, 3);
+    CHECK(ddp_stats()->out_of_order == 2);
+    CHECK(test_buf[0] == 0x00020103);
+    CHECK(frames_seen == 1);
+}
+
+static void test_timeout(void) {
+    start();
+    send_rgb(DDP_FLAG_PUSH, 10, 0, 3);
+    CHECK(ddp_is_streaming());
+    fake_time += DDP_TIMEOUT * 1000 - 1;
+    CHECK(ddp_is_streaming());
+    fake_time += 1;
+    CHECK(!ddp_is_streaming());
+
+    // A stream that comes back may have restarted its sequence.
+    send_rgb(DDP_FLAG_PUSH, 2, 0, 3);
+    CHECK(ddp_stats()->out_of_order == 0);
+    CHECK(ddp_stats()->packets == 2);
+    CHECK(ddp_is_streaming());
+}
+
+static void test_destinations(void) {
+    start();
+    send(DDP_FLAG_PUSH, 1, DDP_TYPE_RGB8, DDP_ID_DISPLAY + 1, 0, 3);
+    CHECK(frames_seen == 1);
+    CHECK(test_buf[0] == TEST_FILL);
+    CHECK(second_buf[0] == 0x00020103);
+    CHECK(ddp_is_streaming());
+    CHECK(!ddp_is_streaming_to(0));
+    CHECK(ddp_is_streaming_to(1));
+
+    // The end of the buffer is the end of the output the packet is for.
+    send_rgb(0, 2, 0, TEST_SECOND_LEDS * 3);
+    CHECK(frames_seen == 1);
+    send(0, 3, DDP_TYPE_RGB8, DDP_ID_DISPLAY + 1, 0, TEST_SECOND_LEDS * 3);
+    CHECK(frames_seen == 2);
+    CHECK(second_buf[TEST_SECOND_LEDS] == TEST_FILL);
+
+    // Sending to all of them writes each, clipped to its own length.
+    send(0, 4, DDP_TYPE_RGB8, DDP_ID_ALL, 6, 9);
+    CHECK(frames_seen == 3);
+    CHECK(test_buf[2] == 0x00020103);
+    CHECK(test_buf[4] == 0x00080709);
+    CHECK(second_buf[2] == 0x00020103);
+    CHECK(second_buf[TEST_SECOND_LEDS] == TEST_FILL);
+    CHECK(ddp_is_streaming_to(0));
+    CHECK(ddp_is_streaming_to(1));
+
+    // The outputs are released when the stream times out, and only taken again as they are sent to.
+    fake_time += DDP_TIMEOUT * 1000;
+    CHECK(!ddp_is_streaming_to(0));
+    CHECK(!ddp_is_streaming_to(1));
+    send_rgb(DDP_FLAG_PUSH, 1, 0, 3);
+    CHECK(ddp_is_streaming_to(0));
+    CHECK(!ddp_is_streaming_to(1));
+}
+
+/**
+ * system_get_time wraps every 2^32 µs. A stream that stopped must not look live again when it comes round.
+ */
+static void test_clock_wrap(void) {
+    start();
+    uint32_t last = fake_time;
+    send_rgb(DDP_FLAG_PUSH, 1, 0, 3);
+    for (uint64_t t = 0; t < 2 * (1ull << 32); t += TEST_CHECK_PERIOD) {
+        fake_time = last + t;
+        if (t >= DDP_TIMEOUT * 1000 && ddp_is_streaming()) {
+            printf("FAIL %s: streaming %llu us after the last packet\n", __func__, (unsigned long long)t);
+            ++failures;
+            break;
+        }
+    }
+
+    // Once the timeout has been seen, the clock coming back round to the last packet doesn't revive the stream.
+    start();
+    last = fake_time;
+    send_rgb(DDP_FLAG_PUSH, 1, 0, 3);
+    fake_time = last + DDP_TIMEOUT * 1000;
+    CHECK(!ddp_is_streaming());
+    fake_time = last;
+    CHECK(!ddp_is_streaming());
+    fake_time = last + 1;
+    CHECK(!ddp_is_streaming());
+}
+
+int main(void) {
+    test_init();
+    test_channel_order();
+    test_write_offsets();
+    test_seq_ok();
+    test_frames();
+    test_bad_packets();
+    test_out_of_order();
+    test_timeout();
+    test_destinations();
+    test_clock_wrap();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * Measure the I2S driver's interrupt handler in the simulator.
+ *
+ * Build once with WS2811_I2S_ENCODE_IN_ISR and once without, to compare encoding in the interrupt handler with copying
+ * samples encoded by ws2811_i2s_commit. The times are host CPU time, so only the ratio between builds means anything.
+ * On the device, WS2811_I2S_PROFILE gives CCOUNT cycles.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "i2s_sim.h"
+#include "ws2811-esp8266-i2s.h"
+
+/* --- Macros --- */
+#define BENCH_FRAMES 500
+#define BENCH_TIMEOUT 100000000 // ns
+
+#if WS2811_I2S_ENCODE_IN_ISR
+#define BENCH_NAME "encode in ISR"
+#else
+#define BENCH_NAME "encode in commit"
+#endif
+
+/* --- Data --- */
+static struct ws2811_i2s_context ctx;
+
+/* --- Functions --- */
+static bool is_idle(void) { return !ws2811_i2s_is_sending(&ctx); }
+
+static void bench_isr(size_t len) {
+    i2s_sim_reset();
+    ws2811_i2s_init(&ctx);
+    srand(1);
+    for (size_t i = 0; i < len; ++i) {
+        ctx.pixels[i] = (((uint32_t)rand() << 16) ^ (uint32_t)rand()) & 0xFFFFFF;
+    }
+
+    for (int i = 0; i < BENCH_FRAMES; ++i) {
+        ws2811_i2s_commit(&ctx, len);
+        if (!i2s_sim_run_until(is_idle, BENCH_TIMEOUT)) {
+            printf("%s: timed out\n", BENCH_NAME);
+            exit(1);
+        }
+    }
+
+    const struct i2s_sim_stats *stats = i2s_sim_stats();
+    double ns = i2s_sim_isr_host_ns();
+    printf("%s: %zu pixels, %.1f ISRs per frame, %.0f ns per ISR, %.2f us per frame\n", BENCH_NAME, len,
+           (double)stats->isrs / BENCH_FRAMES, ns / stats->isrs, ns / BENCH_FRAMES / 1000);
+}
+
+int main(void) {
+    bench_isr(WS2811_I2S_MAX_PIXELS);
+    return 0;
+}
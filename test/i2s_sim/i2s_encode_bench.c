@@ -0,0 +1,58 @@
+/**
+ * Measure the I2S encoder's throughput, in colour bytes per µs of host time.
+ *
+ * Build once per WS2811_I2S_LUT to compare the nibble and byte tables. The driver is included, so the encoder can be
+ * called without sending.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ws2811-esp8266-i2s.c"
+
+/* --- Macros --- */
+#define BENCH_MIN_NS 200000000 // Run each size for at least this long
+
+#if WS2811_I2S_LUT == WS2811_I2S_LUT_BYTE
+#define BENCH_NAME "byte table"
+#else
+#define BENCH_NAME "nibble table"
+#endif
+
+/* --- Data --- */
+static struct ws2811_i2s_context ctx;
+
+/* --- Functions --- */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void bench_encode(size_t len) {
+    srand(1);
+    for (size_t i = 0; i < len; ++i) {
+        ctx.pixels[i] = (((uint32_t)rand() << 16) ^ (uint32_t)rand()) & 0xFFFFFF;
+    }
+
+    uint64_t runs = 0;
+    uint64_t start = now_ns();
+    uint64_t ns;
+    do {
+        for (int i = 0; i < 100; ++i) {
+            ws2811_i2s_encode(&ctx, &ctx.frames[i & 1], ctx.pixels, len);
+        }
+        runs += 100;
+        ns = now_ns() - start;
+    } while (ns < BENCH_MIN_NS);
+
+    double bytes = (double)runs * len * WS2811_I2S_BITS_PER_PIXEL / 8;
+    printf("%s: %4zu pixels, %.0f bytes/us, %.2f us per frame\n", BENCH_NAME, len, bytes * 1000 / ns,
+           (double)ns / runs / 1000);
+}
+
+int main(void) {
+    bench_encode(120);
+    bench_encode(1000);
+    return 0;
+}
@@ -0,0 +1,440 @@
+/**
+ * A model of the ESP8266 I2S transmitter, and a WS2812 decoder listening to its data pin.
+ *
+ * The model covers what the driver relies on in FIFO mode:
+ *
+ *  - A 64-word transmit FIFO. WFULL is raised by the write that fills it, and further writes are dropped. PUT_DATA is
+ *    raised while it holds fewer words than the TX_DATA_NUM field. REMPTY is raised when the transmitter takes the
+ *    last word.
+ *  - A bit clock derived from the CLKM and BCK dividers of a 160 MHz base clock, shifting out BITS_MOD + 16 bits of
+ *    each word, MSB first.
+ *  - The behaviour the driver's trailer is sized for: the transmitter holds two frames (four words) beyond the FIFO, so
+ *    REMPTY comes two frames early, it starts each transfer with one zero frame, and if it runs dry it repeats the last
+ *    frame.
+ *
+ * Interrupts are level-sensitive and taken between bits, with no latency. The handler runs in zero emulated time.
+ */
+#include "i2s_sim.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <eagle_soc.h>
+#include <ets_sys.h>
+
+#include "i2s_register.h"
+
+/* --- Macros --- */
+#define I2S_SIM_SPI_INT_ST (PERIPHS_DPORT_BASEADDR | 0x20)
+#define I2S_SIM_SPI_INT_ST_I2S BIT9
+#define I2S_SIM_BASE_FREQ 160 // MHz, before the CLKM and BCK dividers
+#define I2S_SIM_OUT_LEN 4     // Words held by the transmitter beyond the FIFO
+#define I2S_SIM_MAX_REGS 32
+#define I2S_SIM_PS 1000 // ps per ns
+
+/* --- Types --- */
+struct i2s_sim_reg {
+    uint32_t addr;
+    uint32_t val;
+};
+
+/* --- Data --- */
+static struct i2s_sim_reg sim_regs[I2S_SIM_MAX_REGS];
+static int sim_num_regs;
+
+static uint32_t sim_fifo[I2S_SIM_FIFO_LEN];
+static int sim_fifo_head;
+static int sim_fifo_count;
+static uint32_t sim_raw;
+static uint32_t sim_ena;
+static uint32_t sim_conf;
+static uint32_t sim_fifo_conf;
+
+static bool sim_running;
+static uint32_t sim_out[I2S_SIM_OUT_LEN];
+static int sim_out_count;
+static uint32_t sim_last[2]; // The last frame shifted out, for repeating
+static int sim_repeat;       // The next word of sim_last to repeat
+static uint32_t sim_word;
+static int sim_bits_left;
+static uint64_t sim_time_ps;
+
+static void (*sim_isr)(void *arg);
+static void *sim_isr_arg;
+static bool sim_masked;
+static bool sim_in_isr;
+static uint64_t sim_isr_host_ns;
+static uint64_t sim_clock_ns; // The cost of reading the clock, taken off every measurement
+
+// The decoder.
+static int sim_level;
+static uint64_t sim_run_ps; // How long the wire has been at sim_level
+static bool sim_have_high;  // Whether a high time is waiting for its low time
+static int sim_high_bit;
+static struct i2s_sim_stats sim_stats;
+static struct i2s_sim_frame sim_frame; // The frame being received
+
+/* --- Functions --- */
+static uint32_t *sim_reg(uint32_t addr) {
+    for (int i = 0; i < sim_num_regs; ++i) {
+        if (sim_regs[i].addr == addr) {
+            return &sim_regs[i].val;
+        }
+    }
+    if (sim_num_regs == I2S_SIM_MAX_REGS) {
+        static uint32_t scratch;
+        return &scratch;
+    }
+    sim_regs[sim_num_regs].addr = addr;
+    sim_regs[sim_num_regs].val = 0;
+    return &sim_regs[sim_num_regs++].val;
+}
+
+static uint64_t sim_bit_ps(void) {
+    uint32_t div =
+        ((sim_conf >> I2S_BCK_DIV_NUM_S) & I2S_BCK_DIV_NUM) * ((sim_conf >> I2S_CLKM_DIV_NUM_S) & I2S_CLKM_DIV_NUM);
+    return (uint64_t)(div ? div : 1) * 1000000 / I2S_SIM_BASE_FREQ;
+}
+
+static int sim_bits_per_word(void) { return 16 + ((sim_conf >> I2S_BITS_MOD_S) & I2S_BITS_MOD); }
+
+static void sim_update_put_data(void) {
+    if (sim_fifo_count < (int)((sim_fifo_conf >> I2S_I2S_TX_DATA_NUM_S) & I2S_I2S_TX_DATA_NUM)) {
+        sim_raw |= I2S_I2S_TX_PUT_DATA_INT_RAW;
+    }
+}
+
+/**
+ * Move words from the FIFO into the transmitter.
+ */
+static void sim_prefetch(void) {
+    if (sim_out_count == I2S_SIM_OUT_LEN) {
+        return;
+    }
+    bool took = false;
+    while (sim_out_count < I2S_SIM_OUT_LEN && sim_fifo_count) {
+        sim_out[sim_out_count++] = sim_fifo[sim_fifo_head];
+        sim_fifo_head = (sim_fifo_head + 1) % I2S_SIM_FIFO_LEN;
+        --sim_fifo_count;
+        took = true;
+    }
+    if (took && !sim_fifo_count) {
+        sim_raw |= I2S_I2S_TX_REMPTY_INT_RAW;
+    }
+    sim_update_put_data();
+}
+
+static void sim_fifo_reset(void) {
+    sim_fifo_head = 0;
+    sim_fifo_count = 0;
+    sim_out_count = 0;
+    sim_bits_left = 0;
+}
+
+static void sim_start(void) {
+    sim_running = true;
+    sim_bits_left = 0;
+    sim_out[0] = 0;
+    sim_out[1] = 0;
+    sim_out_count = 2;
+    sim_last[0] = 0;
+    sim_last[1] = 0;
+    sim_prefetch();
+}
+
+uint32_t host_reg_read(uint32_t addr) {
+    switch (addr) {
+    case I2SINT_RAW:
+        return sim_raw;
+    case I2SINT_ST:
+        return sim_raw & sim_ena;
+    case I2SINT_ENA:
+        return sim_ena;
+    case I2SCONF:
+        return sim_conf;
+    case I2S_FIFO_CONF:
+        return sim_fifo_conf;
+    case I2S_SIM_SPI_INT_ST:
+        return sim_raw & sim_ena ? I2S_SIM_SPI_INT_ST_I2S : 0;
+    default:
+        return *sim_reg(addr);
+    }
+}
+
+void host_reg_write(uint32_t addr, uint32_t val) {
+    switch (addr) {
+    case I2STXFIFO:
+        if (sim_fifo_count == I2S_SIM_FIFO_LEN) {
+            ++sim_stats.fifo_overflows;
+            return;
+        }
+        sim_fifo[(sim_fifo_head + sim_fifo_count++) % I2S_SIM_FIFO_LEN] = val;
+        if (sim_fifo_count == I2S_SIM_FIFO_LEN) {
+            sim_raw |= I2S_I2S_TX_WFULL_INT_RAW;
+        }
+        if (sim_running) {
+            sim_prefetch();
+        }
+        return;
+
+    case I2SINT_CLR:
+        sim_raw &= ~val;
+        sim_update_put_data();
+        return;
+
+    case I2SINT_ENA:
+        sim_ena = val;
+        return;
+
+    case I2S_FIFO_CONF:
+        sim_fifo_conf = val;
+        return;
+
+    case I2SCONF: {
+        uint32_t old = sim_conf;
+        sim_conf = val;
+        if (val & (I2S_I2S_TX_RESET | I2S_I2S_TX_FIFO_RESET)) {
+            sim_fifo_reset();
+        }
+        if ((val & I2S_I2S_TX_START) && !(old & I2S_I2S_TX_START)) {
+            sim_start();
+        } else if (!(val & I2S_I2S_TX_START)) {
+            sim_running = false;
+        }
+        return;
+    }
+
+    default:
+        *sim_reg(addr) = val;
+        return;
+    }
+}
+
+void ets_isr_attach(int intr, void (*handler)(void *), void *arg) {
+    if (intr == ETS_SPI_INUM) {
+        sim_isr = handler;
+        sim_isr_arg = arg;
+    }
+}
+
+void ets_isr_mask(uint32_t mask) {
+    if (mask & (1 << ETS_SPI_INUM)) {
+        sim_masked = true;
+    }
+}
+
+void ets_isr_unmask(uint32_t mask) {
+    if (mask & (1 << ETS_SPI_INUM)) {
+        sim_masked = false;
+    }
+}
+
+void ets_timer_arm_new(ETSTimer *timer, int time, int repeat, int is_ms) {}
+
+void ets_timer_disarm(ETSTimer *timer) {}
+
+void ets_timer_setfn(ETSTimer *timer, ETSTimerFunc *func, void *arg) {}
+
+void rom_i2c_writeReg_Mask(uint8_t block, uint8_t host_id, uint32_t reg_add, uint8_t msb, uint8_t lsb,
+                           uint8_t indata) {}
+
+static bool sim_in_spec(uint64_t ps, uint32_t nominal) {
+    return ps + I2S_SIM_TOLERANCE * I2S_SIM_PS >= (uint64_t)nominal * I2S_SIM_PS &&
+           ps <= (uint64_t)(nominal + I2S_SIM_TOLERANCE) * I2S_SIM_PS;
+}
+
+static void sim_add_bit(int bit) {
+    struct i2s_sim_frame *f = &sim_frame;
+    size_t px = f->bits / 24;
+    int byte = f->bits / 8 % 3;
+    int shift = 8 * byte + 7 - f->bits % 8;
+    if (px < I2S_SIM_MAX_PIXELS) {
+        if (!(f->bits % 24)) {
+            f->pixels[px] = 0;
+        }
+        f->pixels[px] |= (uint32_t)bit << shift;
+    }
+    if (!(++f->bits % 24)) {
+        ++f->len;
+    }
+}
+
+static void sim_latch(void) {
+    if (sim_stats.num_frames < I2S_SIM_MAX_FRAMES) {
+        sim_stats.frames[sim_stats.num_frames] = sim_frame;
+    }
+    ++sim_stats.num_frames;
+    sim_frame.len = 0;
+    sim_frame.bits = 0;
+}
+
+/**
+ * Decode one period of constant level on the data pin, ended by an edge.
+ */
+static void sim_decode(int level, uint64_t ps) {
+    if (level) {
+        if (sim_in_spec(ps, I2S_SIM_T0H)) {
+            sim_high_bit = 0;
+        } else if (sim_in_spec(ps, I2S_SIM_T1H)) {
+            sim_high_bit = 1;
+        } else {
+            ++sim_stats.timing_errors;
+            sim_high_bit = ps > (I2S_SIM_T0H + I2S_SIM_T1H) / 2 * I2S_SIM_PS;
+        }
+        sim_have_high = true;
+        return;
+    }
+
+    if (ps >= (uint64_t)I2S_SIM_TRES * I2S_SIM_PS) {
+        // The last bit's low time runs into the reset.
+        if (sim_have_high) {
+            sim_add_bit(sim_high_bit);
+            sim_have_high = false;
+        }
+        if (sim_frame.bits) {
+            sim_latch();
+        }
+        if (sim_stats.num_frames && (!sim_stats.min_reset_ns || ps / I2S_SIM_PS < sim_stats.min_reset_ns)) {
+            sim_stats.min_reset_ns = ps / I2S_SIM_PS;
+        }
+        return;
+    }
+
+    if (!sim_have_high) {
+        // Idle before the first frame.
+        if (sim_frame.bits || sim_stats.num_frames) {
+            ++sim_stats.timing_errors;
+        }
+        return;
+    }
+    if (!sim_in_spec(ps, sim_high_bit ? I2S_SIM_T1L : I2S_SIM_T0L)) {
+        ++sim_stats.timing_errors;
+    }
+    sim_add_bit(sim_high_bit);
+    sim_have_high = false;
+}
+
+static void sim_wire(int level, uint64_t ps) {
+    if (level != sim_level) {
+        sim_decode(sim_level, sim_run_ps);
+        sim_level = level;
+        sim_run_ps = 0;
+    }
+    sim_run_ps += ps;
+    sim_time_ps += ps;
+}
+
+static uint64_t sim_elapsed_ns(const struct timespec *start, const struct timespec *end) {
+    return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000 + end->tv_nsec - start->tv_nsec;
+}
+
+static void sim_calibrate_clock(void) {
+    sim_clock_ns = UINT64_MAX;
+    for (int i = 0; i < 1000; ++i) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        uint64_t ns = sim_elapsed_ns(&start, &end);
+        if (ns < sim_clock_ns) {
+            sim_clock_ns = ns;
+        }
+    }
+}
+
+static void sim_dispatch(void) {
+    if (!sim_isr || sim_masked || sim_in_isr || !(sim_raw & sim_ena)) {
+        return;
+    }
+
+    struct timespec start, end;
+    sim_in_isr = true;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sim_isr(sim_isr_arg);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sim_in_isr = false;
+    uint64_t ns = sim_elapsed_ns(&start, &end);
+    sim_isr_host_ns += ns > sim_clock_ns ? ns - sim_clock_ns : 0;
+    ++sim_stats.isrs;
+}
+
+/**
+ * Shift out one bit, or keep the line low for one bit time if the transmitter is stopped.
+ */
+static void sim_step(void) {
+    sim_dispatch();
+
+    uint64_t ps = sim_bit_ps();
+    if (!sim_running) {
+        sim_wire(0, ps);
+        return;
+    }
+
+    if (!sim_bits_left) {
+        if (sim_out_count) {
+            sim_word = sim_out[0];
+            memmove(sim_out, sim_out + 1, --sim_out_count * sizeof(*sim_out));
+            sim_last[0] = sim_last[1];
+            sim_last[1] = sim_word;
+            sim_repeat = 0;
+        } else {
+            sim_word = sim_last[sim_repeat];
+            sim_repeat ^= 1;
+            ++sim_stats.repeated_words;
+        }
+        sim_bits_left = sim_bits_per_word();
+        sim_prefetch();
+    }
+
+    sim_wire(sim_word >> 31, ps);
+    sim_word <<= 1;
+    --sim_bits_left;
+}
+
+void i2s_sim_reset(void) {
+    sim_num_regs = 0;
+    sim_raw = 0;
+    sim_ena = 0;
+    sim_conf = 0;
+    sim_fifo_conf = 0;
+    sim_running = false;
+    sim_fifo_reset();
+    sim_time_ps = 0;
+    sim_isr = NULL;
+    sim_masked = false;
+    sim_in_isr = false;
+    sim_isr_host_ns = 0;
+    sim_calibrate_clock();
+    sim_level = 0;
+    sim_run_ps = 0;
+    sim_have_high = false;
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    memset(&sim_frame, 0, sizeof(sim_frame));
+}
+
+void i2s_sim_run(uint64_t ns) {
+    uint64_t end = sim_time_ps + ns * I2S_SIM_PS;
+    while (sim_time_ps < end) {
+        sim_step();
+    }
+}
+
+bool i2s_sim_run_until(bool (*cond)(void), uint64_t max_ns) {
+    uint64_t end = sim_time_ps + max_ns * I2S_SIM_PS;
+    while (!cond()) {
+        if (sim_time_ps >= end) {
+            return false;
+        }
+        sim_step();
+    }
+    return true;
+}
+
+const struct i2s_sim_stats *i2s_sim_stats(void) {
+    if (!sim_level && sim_run_ps >= (uint64_t)I2S_SIM_TRES * I2S_SIM_PS && (sim_have_high || sim_frame.bits)) {
+        sim_decode(0, sim_run_ps);
+    }
+    sim_stats.time_ns = sim_time_ps / I2S_SIM_PS;
+    return &sim_stats;
+}
+
+uint64_t i2s_sim_isr_host_ns(void) { return sim_isr_host_ns; }
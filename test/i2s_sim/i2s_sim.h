@@ -0,0 +1,80 @@
+#ifndef I2S_SIM_H
+#define I2S_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* --- Macros --- */
+/**
+ * The depth of the transmit FIFO, in words.
+ */
+#define I2S_SIM_FIFO_LEN 64
+/**
+ * The most frames and pixels per frame the decoder keeps.
+ */
+#define I2S_SIM_MAX_FRAMES 16
+#define I2S_SIM_MAX_PIXELS 1024
+
+// WS2812B datasheet timing, in ns. Each may be off by I2S_SIM_TOLERANCE.
+#define I2S_SIM_T0H 400
+#define I2S_SIM_T1H 800
+#define I2S_SIM_T0L 850
+#define I2S_SIM_T1L 450
+#define I2S_SIM_TOLERANCE 150
+#define I2S_SIM_TRES 50000
+
+/* --- Types --- */
+/**
+ * A frame as the LEDs saw it.
+ */
+struct i2s_sim_frame {
+    uint32_t pixels[I2S_SIM_MAX_PIXELS]; // Wire bytes, first byte in the lowest bits, as in the driver's buffer
+    size_t len;                          // In pixels
+    uint32_t bits;                       // Bits received, including any partial pixel
+};
+
+/**
+ * Everything the model has seen since i2s_sim_reset.
+ */
+struct i2s_sim_stats {
+    uint64_t time_ns;
+    uint32_t isrs;             // Calls into the I2S interrupt handler
+    uint32_t fifo_overflows;   // Words written while the FIFO was full
+    uint32_t repeated_words;   // Words the transmitter repeated because the FIFO ran dry
+    uint32_t timing_errors;    // High or low times outside the datasheet limits
+    uint32_t min_reset_ns;     // The shortest reset seen between frames
+    uint32_t num_frames;       // Frames decoded. Only the first I2S_SIM_MAX_FRAMES are kept.
+    struct i2s_sim_frame frames[I2S_SIM_MAX_FRAMES];
+};
+
+/* --- Functions --- */
+/**
+ * Reset the peripheral model and the decoder. The driver must be initialized afterwards.
+ */
+extern void i2s_sim_reset(void);
+
+/**
+ * Advance the emulated bit clock by ns, shifting bits out to the decoder, and calling the interrupt handler when an
+ * enabled interrupt is raised and not masked.
+ */
+extern void i2s_sim_run(uint64_t ns);
+
+/**
+ * Advance until cond returns true, checking it after every bit, or until max_ns has passed.
+ *
+ * @return whether cond returned true.
+ */
+extern bool i2s_sim_run_until(bool (*cond)(void), uint64_t max_ns);
+
+/**
+ * Return what the model has seen. Ends any reset in progress, so the last frame is counted.
+ */
+extern const struct i2s_sim_stats *i2s_sim_stats(void);
+
+/**
+ * Return the host CPU time spent in the interrupt handler, in ns, not counting the time to read the clock.
+ */
+extern uint64_t i2s_sim_isr_host_ns(void);
+
+#endif /* I2S_SIM_H */
@@ -0,0 +1,146 @@
+/**
+ * Send frames through the I2S driver in FIFO mode, and check what the LEDs would see.
+ *
+ * Every frame must arrive intact, with every high and low time within the WS2812B datasheet limits, at least
+ * I2S_SIM_TRES of reset between frames, and without the FIFO running dry. Prints the fill interrupts per frame.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "i2s_sim.h"
+#include "ws2811-esp8266-i2s.h"
+
+/* --- Macros --- */
+#define TEST_TIMEOUT 100000000 // ns
+
+/* --- Data --- */
+static struct ws2811_i2s_context ctx;
+static uint32_t frames_done;
+static uint32_t frame_isrs[I2S_SIM_MAX_FRAMES];
+static uint32_t last_done_isrs;
+static int failures;
+
+/* --- Functions --- */
+static void frame_done(void *arg) {
+    const struct i2s_sim_stats *stats = i2s_sim_stats();
+    if (frames_done < I2S_SIM_MAX_FRAMES) {
+        frame_isrs[frames_done] = stats->isrs - last_done_isrs;
+    }
+    last_done_isrs = stats->isrs;
+    ++frames_done;
+}
+
+static bool is_idle(void) { return !ws2811_i2s_is_sending(&ctx); }
+
+static void setup(void) {
+    i2s_sim_reset();
+    ws2811_i2s_init(&ctx);
+    ws2811_i2s_set_frame_done_cb(&ctx, frame_done, NULL);
+    frames_done = 0;
+    last_done_isrs = 0;
+}
+
+static void fill(uint32_t seed, size_t len) {
+    srand(seed);
+    for (size_t i = 0; i < len; ++i) {
+        ctx.pixels[i] = (((uint32_t)rand() << 16) ^ (uint32_t)rand()) & 0xFFFFFF;
+    }
+}
+
+static void check(bool ok, const char *what, size_t len) {
+    if (!ok) {
+        printf("FAIL %zu pixels: %s\n", len, what);
+        ++failures;
+    }
+}
+
+static void check_frame(const struct i2s_sim_stats *stats, uint32_t i, uint32_t seed, size_t len) {
+    if (i >= stats->num_frames) {
+        check(false, "frame missing", len);
+        return;
+    }
+    const struct i2s_sim_frame *f = &stats->frames[i];
+    check(f->len == len && f->bits == len * 24, "wrong length", len);
+    fill(seed, len);
+    for (size_t j = 0; j < len && j < f->len; ++j) {
+        if (f->pixels[j] != ctx.pixels[j]) {
+            printf("  pixel %zu: sent %06x, got %06x\n", j, (unsigned)ctx.pixels[j], (unsigned)f->pixels[j]);
+            check(false, "wrong pixel", len);
+            break;
+        }
+    }
+}
+
+static void check_stats(const struct i2s_sim_stats *stats, uint32_t frames, size_t len) {
+    check(stats->num_frames == frames, "wrong number of frames", len);
+    check(!stats->timing_errors, "timing out of spec", len);
+    check(!stats->fifo_overflows, "FIFO overflow", len);
+    check(!stats->repeated_words, "FIFO ran dry", len);
+    check(stats->min_reset_ns >= I2S_SIM_TRES, "reset too short", len);
+    check(ctx.superseded_frames == 0, "frame superseded", len);
+}
+
+/**
+ * Send a few frames back to back, committing the next as soon as the previous one is done.
+ */
+static void test_back_to_back(size_t len) {
+    setup();
+    for (uint32_t i = 0; i < 3; ++i) {
+        fill(i + 1, len);
+        ws2811_i2s_commit(&ctx, len);
+        check(i2s_sim_run_until(is_idle, TEST_TIMEOUT), "timed out", len);
+    }
+    i2s_sim_run(2 * I2S_SIM_TRES);
+
+    const struct i2s_sim_stats *stats = i2s_sim_stats();
+    check_stats(stats, 3, len);
+    check(frames_done == 3, "frame done not called once per frame", len);
+    for (uint32_t i = 0; i < 3 && i < stats->num_frames; ++i) {
+        check_frame(stats, i, i + 1, len);
+    }
+    printf("%4zu pixels: %u ISRs per frame, reset %u ns\n", len, (unsigned)frame_isrs[1],
+           (unsigned)stats->min_reset_ns);
+}
+
+/**
+ * Commit while a frame is being sent, so the next one is latched by the interrupt handler, and replace a waiting frame.
+ */
+static void test_pending(size_t len) {
+    setup();
+    fill(1, len);
+    ws2811_i2s_commit(&ctx, len);
+    i2s_sim_run(10000);
+    fill(2, len);
+    ws2811_i2s_commit(&ctx, len);
+    fill(3, len);
+    ws2811_i2s_commit(&ctx, len);
+    check(i2s_sim_run_until(is_idle, TEST_TIMEOUT), "timed out", len);
+    i2s_sim_run(2 * I2S_SIM_TRES);
+
+    const struct i2s_sim_stats *stats = i2s_sim_stats();
+    check(stats->num_frames == 2, "wrong number of frames", len);
+    check(!stats->timing_errors && !stats->repeated_words, "bad wave while latching", len);
+    check(stats->min_reset_ns >= I2S_SIM_TRES, "reset too short", len);
+    check(ctx.commits - ctx.latches == 1, "superseded frame was sent", len);
+    check_frame(stats, 0, 1, len);
+    check_frame(stats, 1, 3, len);
+    // Counted when the next commit sees it.
+    ws2811_i2s_commit(&ctx, len);
+    check(ctx.superseded_frames == 1, "superseded frame not counted", len);
+}
+
+int main(void) {
+    // Odd and even lengths, since the trailer pads the frame to a whole number of stereo samples.
+    static const size_t LENS[] = {1, 2, 7, 60, WS2811_I2S_MAX_PIXELS};
+    for (size_t i = 0; i < sizeof(LENS) / sizeof(*LENS); ++i) {
+        test_back_to_back(LENS[i]);
+        test_pending(LENS[i]);
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,24 @@
+/**
+ * Host stand-in for the SDK's eagle_soc.h, for the host tests.
+ *
+ * Register accesses go through host_reg_read and host_reg_write, which the test defines, e.g. as a peripheral model.
+ */
+#ifndef HOST_EAGLE_SOC_H
+#define HOST_EAGLE_SOC_H
+
+#include "c_types.h"
+
+/* --- Macros --- */
+#define READ_PERI_REG(addr) host_reg_read((uint32_t)(addr))
+#define WRITE_PERI_REG(addr, val) host_reg_write((uint32_t)(addr), (uint32_t)(val))
+#define CLEAR_PERI_REG_MASK(reg, mask) WRITE_PERI_REG((reg), (READ_PERI_REG(reg) & (~(mask))))
+#define SET_PERI_REG_MASK(reg, mask) WRITE_PERI_REG((reg), (READ_PERI_REG(reg) | (mask)))
+
+#define PERIPHS_DPORT_BASEADDR 0x3ff00000
+#define APB_CLK_FREQ 80000000
+
+/* --- Functions --- */
+extern uint32_t host_reg_read(uint32_t addr);
+extern void host_reg_write(uint32_t addr, uint32_t val);
+
+#endif /* HOST_EAGLE_SOC_H */
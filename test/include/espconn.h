@@ -0,0 +1,36 @@
+/**
+ * Host stand-in for the SDK's espconn.h, for the host tests. The test defines the functions it uses.
+ */
+#ifndef HOST_ESPCONN_H
+#define HOST_ESPCONN_H
+
+#include "c_types.h"
+
+/* --- Macros --- */
+#define ESPCONN_UDP 0x20
+
+/* --- Types --- */
+typedef void (*espconn_recv_callback)(void *arg, char *pdata, unsigned short len);
+
+typedef struct _esp_udp {
+    int remote_port;
+    int local_port;
+    uint8 local_ip[4];
+    uint8 remote_ip[4];
+} esp_udp;
+
+struct espconn {
+    int type;
+    int state;
+    union {
+        esp_udp *udp;
+    } proto;
+    espconn_recv_callback recv_callback;
+    void *reverse;
+};
+
+/* --- Functions --- */
+extern sint8 espconn_create(struct espconn *espconn);
+extern sint8 espconn_regist_recvcb(struct espconn *espconn, espconn_recv_callback recv_cb);
+
+#endif /* HOST_ESPCONN_H */
@@ -0,0 +1,44 @@
+/**
+ * Host stand-in for the SDK's ets_sys.h, for the host tests.
+ */
+#ifndef HOST_ETS_SYS_H
+#define HOST_ETS_SYS_H
+
+#include "c_types.h"
+#include "eagle_soc.h"
+
+/* --- Macros --- */
+#define ETS_SLC_INUM 1
+#define ETS_SPI_INUM 2
+
+#define ETS_SPI_INTR_ATTACH(func, arg) ets_isr_attach(ETS_SPI_INUM, (void (*)(void *))(func), (void *)(arg))
+#define ETS_SPI_INTR_DISABLE() ets_isr_mask(1 << ETS_SPI_INUM)
+#define ETS_SPI_INTR_ENABLE() ets_isr_unmask(1 << ETS_SPI_INUM)
+
+/* --- Types --- */
+typedef void ETSTimerFunc(void *timer_arg);
+
+typedef struct _ETSTIMER_ {
+    struct _ETSTIMER_ *timer_next;
+    uint32_t timer_expire;
+    uint32_t timer_period;
+    ETSTimerFunc *timer_func;
+    void *timer_arg;
+} ETSTimer;
+
+typedef uint32_t ETSSignal;
+typedef uint32_t ETSParam;
+
+typedef struct ETSEventTag {
+    ETSSignal sig;
+    ETSParam par;
+} ETSEvent;
+
+typedef void (*ETSTask)(ETSEvent *e);
+
+/* --- Functions --- */
+extern void ets_isr_attach(int intr, void (*handler)(void *), void *arg);
+extern void ets_isr_mask(uint32_t mask);
+extern void ets_isr_unmask(uint32_t mask);
+
+#endif /* HOST_ETS_SYS_H */
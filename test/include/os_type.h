@@ -0,0 +1,13 @@
+/**
+ * Host stand-in for the SDK's os_type.h, for the host tests.
+ */
+#ifndef HOST_OS_TYPE_H
+#define HOST_OS_TYPE_H
+
+#include "ets_sys.h"
+
+#define os_timer_t ETSTimer
+#define os_timer_func_t ETSTimerFunc
+#define os_event_t ETSEvent
+
+#endif /* HOST_OS_TYPE_H */
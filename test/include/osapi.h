@@ -0,0 +1,29 @@
+/**
+ * Host stand-in for the SDK's osapi.h, for the host tests.
+ */
+#ifndef HOST_OSAPI_H
+#define HOST_OSAPI_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "c_types.h"
+#include "os_type.h"
+
+#define os_memcmp memcmp
+#define os_memcpy memcpy
+#define os_memset memset
+#define os_strcmp strcmp
+#define os_strlen strlen
+#define os_printf printf
+#define os_sprintf sprintf
+
+#define os_timer_arm(timer, ms, repeat) ets_timer_arm_new(timer, ms, repeat, 1)
+#define os_timer_disarm ets_timer_disarm
+#define os_timer_setfn ets_timer_setfn
+
+extern void ets_timer_arm_new(ETSTimer *timer, int time, int repeat, int is_ms);
+extern void ets_timer_disarm(ETSTimer *timer);
+extern void ets_timer_setfn(ETSTimer *timer, ETSTimerFunc *func, void *arg);
+
+#endif /* HOST_OSAPI_H */
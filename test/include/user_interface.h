@@ -0,0 +1,15 @@
+/**
+ * Host stand-in for the SDK's user_interface.h, for the host tests.
+ */
+#ifndef HOST_USER_INTERFACE_H
+#define HOST_USER_INTERFACE_H
+
+#include "c_types.h"
+#include "os_type.h"
+
+/**
+ * Defined by the test, e.g. as a settable fake clock.
+ */
+extern uint32 system_get_time(void);
+
+#endif /* HOST_USER_INTERFACE_H */
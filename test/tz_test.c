@@ -0,0 +1,83 @@
+/**
+ * Compare tz_localtime_r and tz_name with glibc's localtime_r, every 15 minutes from 2000 to 2050.
+ *
+ * Every zone has explicit rules. For a DST name without rules, glibc uses its posixrules file instead of the US rules
+ * tz_parse assumes, so those can't be compared.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tz.h"
+
+/* --- Macros --- */
+#define TEST_BEGIN 946684800  // 2000-01-01T00:00:00Z
+#define TEST_END 2524608000LL // 2050-01-01T00:00:00Z
+#define TEST_STEP (15 * 60)
+#define TEST_MAX_REPORTS 10
+
+/* --- Data --- */
+static const char *const ZONES[] = {
+    "GMT0IST,M3.5.0/1,M10.5.0",                       // Ireland
+    "CET-1CEST,M3.5.0,M10.5.0/3",                     // Central Europe
+    "EST5EDT,M3.2.0,M11.1.0",                         // US Eastern
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",                   // Sydney: southern hemisphere
+    "NZST-12NZDT,M9.5.0,M4.1.0/3",                    // New Zealand
+    "<-03>3",                                         // Quoted name, no DST
+    "IST-5:30",                                       // India: fractional offset
+    "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45",   // Chatham Islands: fractional offset with DST
+    "WART4WARST,J1/0,J365/25",                        // Permanent DST, with Julian days
+    "EST5EDT,M3.2.0/-1,M11.1.0/26",                   // Negative and over-24h transition times
+    "<+0330>-3:30<+0430>,J79/24,J263/24",             // Old Iran: Julian days at midnight
+};
+
+/* --- Functions --- */
+static bool tm_equal(const struct tm *a, const struct tm *b) {
+    return a->tm_year == b->tm_year && a->tm_mon == b->tm_mon && a->tm_mday == b->tm_mday &&
+           a->tm_hour == b->tm_hour && a->tm_min == b->tm_min && a->tm_sec == b->tm_sec &&
+           a->tm_wday == b->tm_wday && a->tm_yday == b->tm_yday && a->tm_isdst == b->tm_isdst;
+}
+
+static int test_zone(const char *s) {
+    struct tz tz;
+    if (!tz_parse(&tz, s)) {
+        printf("FAIL %s: doesn't parse\n", s);
+        return 1;
+    }
+    setenv("TZ", s, 1);
+    tzset();
+
+    int failures = 0;
+    for (time_t t = TEST_BEGIN; t < TEST_END; t += TEST_STEP) {
+        struct tm got, want;
+        tz_localtime_r(&tz, &t, &got);
+        localtime_r(&t, &want);
+        const char *name = tz_name(&tz, t);
+        if (tm_equal(&got, &want) && !strcmp(name, want.tm_zone)) {
+            continue;
+        }
+        if (failures++ < TEST_MAX_REPORTS) {
+            printf("FAIL %s at %lld: %04d-%02d-%02d %02d:%02d %s dst %d, want %04d-%02d-%02d %02d:%02d %s dst %d\n", s,
+                   (long long)t, got.tm_year + 1900, got.tm_mon + 1, got.tm_mday, got.tm_hour, got.tm_min, name,
+                   got.tm_isdst, want.tm_year + 1900, want.tm_mon + 1, want.tm_mday, want.tm_hour, want.tm_min,
+                   want.tm_zone, want.tm_isdst);
+        }
+    }
+    return failures;
+}
+
+int main(void) {
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(ZONES) / sizeof(*ZONES); ++i) {
+        failures += test_zone(ZONES[i]);
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
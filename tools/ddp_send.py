@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Stream a test pattern to the sign over DDP, or act as a sign to measure the stream.
+
+Send a rotating rainbow to the sign at 50 Hz:
+
+    tools/ddp_send.py 192.168.1.42
+
+The destination ID picks the chain: 1 for the first, 2 for the second, 255 for all of them.
+
+Measure throughput and latency without hardware, in two terminals:
+
+    tools/ddp_send.py --listen
+    tools/ddp_send.py --timecode 127.0.0.1
+
+With --timecode, each packet carries the time it was sent, and the listener reports how long it took to arrive. This
+only makes sense when both run on the same host. The listener applies the same checks as the firmware.
+"""
+
+import argparse
+import colorsys
+import socket
+import struct
+import time
+
+DDP_PORT = 4048
+VERSION_1 = 0x40
+FLAG_TIMECODE = 0x10
+FLAG_PUSH = 0x01
+TYPE_RGB8 = 0x0B
+ID_DISPLAY = 1
+ID_ALL = 255
+HEADER = struct.Struct(">BBBBIH")
+TIMECODE = struct.Struct(">I")
+
+
+def timecode():
+    """Return the current time as 16.16 seconds, wrapped to 32 bits, as DDP timecodes are."""
+    return int(time.monotonic() * 65536) & 0xFFFFFFFF
+
+
+def rainbow(n, phase):
+    """Return n RGB pixels of a rainbow, rotated by phase (0-1)."""
+    out = bytearray()
+    for i in range(n):
+        r, g, b = colorsys.hsv_to_rgb((i / n + phase) % 1.0, 1.0, 0.5)
+        out += bytes((int(r * 255), int(g * 255), int(b * 255)))
+    return bytes(out)
+
+
+def send(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    period = 1.0 / args.rate
+    per_packet = args.packet_pixels * 3
+    seq = 0
+    frames = 0
+    start = next_time = time.monotonic()
+
+    while args.frames == 0 or frames < args.frames:
+        data = rainbow(args.pixels, frames / (args.rate * args.period))
+        for offset in range(0, len(data), per_packet):
+            seq = seq % 15 + 1
+            chunk = data[offset:offset + per_packet]
+            flags = VERSION_1
+            if offset + per_packet >= len(data) and not args.no_push:
+                flags |= FLAG_PUSH
+            if args.timecode:
+                flags |= FLAG_TIMECODE
+            packet = bytearray()
+            packet += HEADER.pack(flags, seq, TYPE_RGB8, args.id, offset, len(chunk))
+            if args.timecode:
+                packet += TIMECODE.pack(timecode())
+            packet += chunk
+            sock.sendto(packet, (args.host, args.port))
+        frames += 1
+
+        next_time += period
+        delay = next_time - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+        else:
+            next_time = time.monotonic()
+
+        if frames % args.rate == 0:
+            elapsed = time.monotonic() - start
+            print("sent %d frames, %.1f fps" % (frames, frames / elapsed))
+
+
+def listen(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    total = args.pixels * 3
+    stats = dict.fromkeys(("packets", "frames", "bad", "out_of_order", "bytes"), 0)
+    latencies = []
+    last_seq = 0
+    start = report_time = time.monotonic()
+
+    while True:
+        packet = sock.recv(2048)
+        if len(packet) < HEADER.size:
+            stats["bad"] += 1
+            continue
+        flags, seq, _, _, offset, length = HEADER.unpack_from(packet)
+        header_len = HEADER.size
+        if flags & 0xC0 != VERSION_1:
+            stats["bad"] += 1
+            continue
+        if flags & FLAG_TIMECODE:
+            (sent,) = TIMECODE.unpack_from(packet, header_len)
+            header_len += TIMECODE.size
+            latencies.append(((timecode() - sent) & 0xFFFFFFFF) / 65536.0)
+        if len(packet) < header_len + length:
+            stats["bad"] += 1
+            continue
+
+        seq &= 0x0F
+        if seq and last_seq:
+            d = seq - last_seq
+            if d <= 0:
+                d += 15
+            if d > 7:
+                stats["out_of_order"] += 1
+                continue
+        if seq:
+            last_seq = seq
+        stats["packets"] += 1
+        stats["bytes"] += len(packet)
+        if flags & FLAG_PUSH or offset + length >= total:
+            stats["frames"] += 1
+
+        now = time.monotonic()
+        if now - report_time >= 1.0:
+            elapsed = now - start
+            line = "%(packets)d packets, %(frames)d frames, %(bad)d bad, %(out_of_order)d out of order" % stats
+            line += ", %.1f fps, %.2f Mbit/s" % (stats["frames"] / elapsed, stats["bytes"] * 8 / elapsed / 1e6)
+            if latencies:
+                latencies.sort()
+                line += ", latency median %.3f ms, max %.3f ms" % (
+                    latencies[len(latencies) // 2] * 1000,
+                    latencies[-1] * 1000,
+                )
+                latencies = []
+            print(line)
+            report_time = now
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", nargs="?", help="the sign's address")
+    parser.add_argument("--listen", action="store_true", help="receive instead of sending, and print statistics")
+    parser.add_argument("--port", type=int, default=DDP_PORT)
+    parser.add_argument("--id", type=int, default=ID_DISPLAY, help="destination ID: the chain, or %d for all" % ID_ALL)
+    parser.add_argument("--pixels", type=int, default=120, help="number of LEDs")
+    parser.add_argument("--packet-pixels", type=int, default=480, help="LEDs per packet, at most 480")
+    parser.add_argument("--rate", type=int, default=50, help="frames per second")
+    parser.add_argument("--period", type=float, default=5.0, help="seconds per rainbow rotation")
+    parser.add_argument("--frames", type=int, default=0, help="stop after this many frames, 0 for never")
+    parser.add_argument("--no-push", action="store_true", help="don't set the push flag")
+    parser.add_argument("--timecode", action="store_true", help="send timecodes, for --listen to measure latency")
+    args = parser.parse_args()
+
+    if args.listen:
+        listen(args)
+    elif args.host:
+        send(args)
+    else:
+        parser.error("a host is needed unless listening")
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass